@@ -0,0 +1,72 @@
+// emitter audibility kernels
+
+#include <math.h>
+
+#include "audibility.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define AUDIBILITY_X86 1
+#include <immintrin.h>
+#define AUDIBILITY_AVX2 __attribute__((target("avx2")))
+#else
+#define AUDIBILITY_X86 0
+#endif
+
+typedef void (*FScore)(const float*, const float*, const float*, const float*, const float*, const float*, float*, int, const float*);
+
+#if AUDIBILITY_X86
+static void Score_SSE2(const float* _X, const float* _Y, const float* _Z, const float* _Gain, const float* _Rolloff, const float* _Bias, float* _Score, int _Count, const float* _L)
+{
+	const __m128 lx = _mm_set1_ps(_L[0]), ly = _mm_set1_ps(_L[1]), lz = _mm_set1_ps(_L[2]);
+	const __m128 one = _mm_set1_ps(1.f);
+	for (int i = 0; i < _Count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_load_ps(_X+i), lx);
+		__m128 dy = _mm_sub_ps(_mm_load_ps(_Y+i), ly);
+		__m128 dz = _mm_sub_ps(_mm_load_ps(_Z+i), lz);
+		__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 att = _mm_max_ps(_mm_mul_ps(_mm_sqrt_ps(d2), _mm_load_ps(_Rolloff+i)), one);
+		__m128 g = _mm_mul_ps(_mm_load_ps(_Gain+i), _mm_load_ps(_Bias+i));
+		_mm_store_ps(_Score+i, _mm_div_ps(g, att));
+	}
+}
+
+AUDIBILITY_AVX2 static void Score_AVX2(const float* _X, const float* _Y, const float* _Z, const float* _Gain, const float* _Rolloff, const float* _Bias, float* _Score, int _Count, const float* _L)
+{
+	const __m256 lx = _mm256_set1_ps(_L[0]), ly = _mm256_set1_ps(_L[1]), lz = _mm256_set1_ps(_L[2]);
+	const __m256 one = _mm256_set1_ps(1.f);
+	for (int i = 0; i < _Count; i += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_load_ps(_X+i), lx);
+		__m256 dy = _mm256_sub_ps(_mm256_load_ps(_Y+i), ly);
+		__m256 dz = _mm256_sub_ps(_mm256_load_ps(_Z+i), lz);
+		__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		__m256 att = _mm256_max_ps(_mm256_mul_ps(_mm256_sqrt_ps(d2), _mm256_load_ps(_Rolloff+i)), one);
+		__m256 g = _mm256_mul_ps(_mm256_load_ps(_Gain+i), _mm256_load_ps(_Bias+i));
+		_mm256_store_ps(_Score+i, _mm256_div_ps(g, att));
+	}
+}
+#else
+static void Score_Scalar(const float* _X, const float* _Y, const float* _Z, const float* _Gain, const float* _Rolloff, const float* _Bias, float* _Score, int _Count, const float* _L)
+{
+	for (int i = 0; i < _Count; i++) {
+		float dx = _X[i] - _L[0], dy = _Y[i] - _L[1], dz = _Z[i] - _L[2];
+		float att = sqrtf(dx*dx + dy*dy + dz*dz) * _Rolloff[i];
+		_Score[i] = _Gain[i] * _Bias[i] / (att > 1.f ? att : 1.f);
+	}
+}
+#endif
+
+static FScore Audibility_Kernel()
+{
+#if AUDIBILITY_X86
+	static const bool s_AVX2 = __builtin_cpu_supports("avx2");
+	return s_AVX2 ? Score_AVX2 : Score_SSE2;
+#else
+	return Score_Scalar;
+#endif
+}
+
+void Audibility_Score(const float* _X, const float* _Y, const float* _Z, const float* _Gain, const float* _Rolloff, const float* _Bias, float* _Score, int _Count, const float _Listener[3])
+{
+	const int count = (_Count + AUDIBILITY_LANES-1) & ~(AUDIBILITY_LANES-1);
+	Audibility_Kernel()(_X, _Y, _Z, _Gain, _Rolloff, _Bias, _Score, count, _Listener);
+}
@@ -0,0 +1,13 @@
+// Audibility of many emitters in one pass over structure of arrays fields:
+// listener distance, inverse clamped distance attenuation and the resulting score.
+
+#pragma once
+
+#define AUDIBILITY_LANES	8		// arrays are 32 bytes aligned and padded to this
+
+// score[i] = gain[i] * bias[i] / max(distance(i, listener) * rolloff[i], 1)
+// (the default distance model with reference distance 1, rolloff 0: not attenuated)
+// _Count is rounded up to AUDIBILITY_LANES, padding entries have a 0 gain.
+void	Audibility_Score(const float* _X, const float* _Y, const float* _Z,
+						 const float* _Gain, const float* _Rolloff, const float* _Bias,
+						 float* _Score, int _Count, const float _Listener[3]);
@@ -0,0 +1,221 @@
+// sound bank
+
+#include <string.h>
+#include <stdio.h>
+
+#include <SDL.h>
+#include <AL/al.h>
+
+#include "common.h"
+#include "sound.h"
+#include "bank.h"
+
+#define BANK_SLOTS	(BANK_MAX_SOUNDS*2)		// open addressing, at most half full
+
+struct SBankSound {
+	uint32_t	hash;		// HashName of the name, relative to the root (in sound.path)
+	SSound		sound;
+	int			refs;
+	Uint32		bytes;
+	Uint32		last_use;
+	int			loads;
+};
+
+struct SBankState {
+	char		Root[256];
+	int			Flags;
+	Uint64		Budget;
+	Uint64		Resident;
+	int			cEvictions;
+	int			cReloads;
+
+	SBankSound	Sounds[BANK_MAX_SOUNDS];	int cSounds;
+	Uint16		Slots[BANK_SLOTS];			// index+1 in Sounds, 0: empty
+};
+static SBankState s_Bank;
+
+// the bank entry of _Sound, NULL for sounds owned elsewhere.
+static SBankSound* Bank_Entry(const SSound& _Sound)
+{
+	const char* p = (const char*)&_Sound;
+	const char* first = (const char*)&s_Bank.Sounds[0].sound;
+	if (p < first || p >= first + s_Bank.cSounds * sizeof(SBankSound))
+		return NULL;
+	return &s_Bank.Sounds[(p - first) / sizeof(SBankSound)];
+}
+
+// the entry of _Name, else NULL and _Slot is where it goes.
+static SBankSound* Bank_Find(const char* _Name, uint32_t _Hash, uint32_t& _Slot)
+{
+	const size_t root = strlen(s_Bank.Root);
+	uint32_t i = _Hash & (BANK_SLOTS-1);
+	for (int probe = 0; probe < BANK_SLOTS; probe++, i = (i+1) & (BANK_SLOTS-1)) {
+		int index = s_Bank.Slots[i];
+		if (index == 0)
+			break;
+		SBankSound& S = s_Bank.Sounds[index-1];
+		if (S.hash == _Hash && strcmp(S.sound.path + root, _Name) == 0)
+			return &S;
+	}
+	_Slot = i;
+	return NULL;
+}
+
+static void Bank_Evict(SBankSound& _S)
+{
+	const ALuint buffer = _S.sound.buffer;
+	Loader_Free(_S.sound);
+	s_Bank.Resident -= _S.bytes;
+	_S.bytes = 0;
+	// a buffer still on a source outlives the delete: Loader_Collect retries it.
+	if (buffer != 0 && alIsBuffer(buffer)) {
+		if (!Loader_Retire(buffer))
+			ERR("Bank_Evict(%s): Buffer %u leaked\n", _S.sound.path, buffer);
+	} else
+		s_Bank.cEvictions++;
+}
+
+bool Bank_Init(const char* _Root, Uint64 _Budget, int _Flags)
+{
+	memset(&s_Bank, 0, sizeof(s_Bank));
+	strncpy(s_Bank.Root, _Root, sizeof(s_Bank.Root)-1);
+	s_Bank.Budget = _Budget;
+	s_Bank.Flags = _Flags;
+	return true;
+}
+
+void Bank_Shutdown()
+{
+	for (int i = 0; i < s_Bank.cSounds; i++)
+		Loader_Free(s_Bank.Sounds[i].sound);
+	memset(&s_Bank, 0, sizeof(s_Bank));
+}
+
+void Bank_SetBudget(Uint64 _Budget)
+{
+	s_Bank.Budget = _Budget;
+}
+
+const SSound* Bank_Sound(const char* _Name)
+{
+	const uint32_t hash = HashName(_Name);
+	uint32_t slot;
+	if (SBankSound* E = Bank_Find(_Name, hash, slot))
+		return &E->sound;
+
+	if (s_Bank.cSounds == BANK_MAX_SOUNDS) {
+		ERR("Bank_Sound(%s): Too many sounds\n", _Name);
+		return NULL;
+	}
+	char path[sizeof(SSound::path)];
+	if (snprintf(path, sizeof(path), "%s%s", s_Bank.Root, _Name) >= (int)sizeof(path)) {
+		ERR("Bank_Sound(%s): Path too long\n", _Name);
+		return NULL;
+	}
+	SBankSound& S = s_Bank.Sounds[s_Bank.cSounds];
+	memset(&S, 0, sizeof(S));
+	S.hash = hash;
+	memcpy(S.sound.path, path, sizeof(path));
+	s_Bank.cSounds++;
+	s_Bank.Slots[slot] = s_Bank.cSounds;
+	return &S.sound;
+}
+
+void Bank_Acquire(const SSound& _Sound)
+{
+	SBankSound* S = Bank_Entry(_Sound);
+	if (S == NULL)
+		return;
+	S->refs++;
+	S->last_use = SDL_GetTicks();
+	if (Sound_State(S->sound) == SOUND_EMPTY) {
+		if (S->loads > 0)
+			s_Bank.cReloads++;
+		S->loads++;
+		Loader_Load(S->sound, S->sound.path, s_Bank.Flags | S->sound.flags);
+	}
+}
+
+void Bank_Release(const SSound& _Sound)
+{
+	SBankSound* S = Bank_Entry(_Sound);
+	if (S == NULL || S->refs == 0)
+		return;
+	S->refs--;
+	S->last_use = SDL_GetTicks();
+}
+
+bool Bank_Reload(const char* _Name)
+{
+	uint32_t slot;
+	SBankSound* S = Bank_Find(_Name, HashName(_Name), slot);
+	if (S == NULL)
+		return false;
+	// evicted ones read the new file on their next load.
+	S->sound.flags |= SOUND_NOPACK;
+	return Loader_Reload(S->sound);
+}
+
+void Bank_Update()
+{
+	for (int i = 0; i < s_Bank.cSounds; i++) {
+		SBankSound& S = s_Bank.Sounds[i];
+		if (Loader_Swap(S.sound)) {
+			s_Bank.Resident -= S.bytes;
+			S.bytes = 0;
+		}
+		if (S.bytes == 0 && Sound_State(S.sound) == SOUND_READY) {
+			ALint size = 0;
+			alGetBufferi(S.sound.buffer, AL_SIZE, &size);
+			S.bytes = size > 0 ? size : 1;
+			s_Bank.Resident += S.bytes;
+		}
+	}
+
+	// least recently used first, sounds still loading or held stay.
+	while (s_Bank.Resident > s_Bank.Budget) {
+		SBankSound* lru = NULL;
+		for (int i = 0; i < s_Bank.cSounds; i++) {
+			SBankSound& S = s_Bank.Sounds[i];
+			if (S.bytes == 0 || S.refs > 0 || Sound_Reloading(S.sound))
+				continue;
+			if (lru == NULL || (Sint32)(S.last_use - lru->last_use) < 0)
+				lru = &S;
+		}
+		if (lru == NULL)
+			break;
+		Bank_Evict(*lru);
+	}
+}
+
+int Bank_Count()
+{
+	return s_Bank.cSounds;
+}
+
+bool Bank_Info(int _Index, SBankInfo& _Info)
+{
+	if (_Index < 0 || _Index >= s_Bank.cSounds)
+		return false;
+	const SBankSound& S = s_Bank.Sounds[_Index];
+	_Info.sound = &S.sound;
+	_Info.refs = S.refs;
+	_Info.bytes = S.bytes;
+	_Info.last_use = S.last_use;
+	_Info.loads = S.loads;
+	return true;
+}
+
+SBankStats Bank_Stats()
+{
+	SBankStats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.cSounds = s_Bank.cSounds;
+	for (int i = 0; i < s_Bank.cSounds; i++)
+		stats.cResident += s_Bank.Sounds[i].bytes != 0;
+	stats.resident = s_Bank.Resident;
+	stats.budget = s_Bank.Budget;
+	stats.cEvictions = s_Bank.cEvictions;
+	stats.cReloads = s_Bank.cReloads;
+	return stats;
+}
@@ -0,0 +1,45 @@
+// Sound bank: sounds looked up by name, loaded on first use by the loader threads,
+// and evicted least recently used once over the byte budget and no source holds them.
+// Evicted sounds load again on their next use. (a single thread, the one updating the sources)
+
+#pragma once
+
+#include "sound.h"
+
+#define BANK_MAX_SOUNDS	256
+
+struct SBankInfo {
+	const SSound*	sound;
+	int				refs;		// playing sources and other holders
+	Uint32			bytes;		// AL buffer size, 0 when not resident
+	Uint32			last_use;	// SDL_GetTicks
+	int				loads;
+};
+
+struct SBankStats {
+	int		cSounds;
+	int		cResident;
+	Uint64	resident;		// bytes
+	Uint64	budget;
+	int		cEvictions;
+	int		cReloads;
+};
+
+bool			Bank_Init(const char* _Root, Uint64 _Budget, int _Flags=0);		// _Flags: ESoundFlags of the loads
+void			Bank_Shutdown();		// (loader threads stopped)
+void			Bank_SetBudget(Uint64 _Budget);
+
+// _Name is relative to the bank root, registered on first call, loaded by the first Bank_Acquire.
+const SSound*	Bank_Sound(const char* _Name);
+
+// held sounds are never evicted, an evicted sound is queued for loading again.
+// (no-op for sounds outside the bank)
+void			Bank_Acquire(const SSound& _Sound);
+void			Bank_Release(const SSound& _Sound);
+
+void			Bank_Update();		// swaps reloaded sounds, accounts loaded ones, evicts over budget
+bool			Bank_Reload(const char* _Name);		// decodes the file again if resident
+
+int				Bank_Count();
+bool			Bank_Info(int _Index, SBankInfo& _Info);
+SBankStats		Bank_Stats();
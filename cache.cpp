@@ -0,0 +1,142 @@
+// decoded sound cache
+
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <SDL.h>
+
+#include "common.h"
+#include "cache.h"
+
+static char s_CacheDir[256];
+
+static void Cache_Path(char* _Path, size_t _Size, uint64_t _Key)
+{
+	snprintf(_Path, _Size, "%s%016llx.pcm", s_CacheDir, (unsigned long long)_Key);
+}
+
+bool Cache_Init(const char* _Dir)
+{
+	s_CacheDir[0] = 0;
+	if (mkdir(_Dir, 0755) != 0 && access(_Dir, W_OK) != 0) {
+		ERR("Cache_Init(%s): not writable, no cache\n", _Dir);
+		return false;
+	}
+	strncpy(s_CacheDir, _Dir, sizeof(s_CacheDir)-1);
+	return true;
+}
+
+void Cache_Shutdown()
+{
+	s_CacheDir[0] = 0;
+}
+
+bool Cache_Enabled()
+{
+	return s_CacheDir[0] != 0;
+}
+
+// 64 bit FNV-1a over words, the tail bytewise.
+uint64_t Cache_Key(const void* _Data, size_t _Size, uint64_t _Settings)
+{
+	const uint64_t prime = 1099511628211ull;
+	uint64_t h = 14695981039346656037ull ^ (_Size * prime);
+	const uint8_t* p = (const uint8_t*)_Data;
+	size_t i = 0;
+	for (; i + 8 <= _Size; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, 8);
+		h = (h ^ w) * prime;
+	}
+	for (; i < _Size; i++)
+		h = (h ^ p[i]) * prime;
+	h = (h ^ _Settings) * prime;
+	h ^= h >> 29;
+	return h ? h : 1;
+}
+
+bool Cache_Open(uint64_t _Key, SCacheFile& _File, SCacheData& _Data)
+{
+	memset(&_File, 0, sizeof(_File));
+	if (!Cache_Enabled())
+		return false;
+
+	char path[320];
+	Cache_Path(path, sizeof(path), _Key);
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SCacheHeader)) {
+		close(fd);
+		return false;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	const SCacheHeader* H = (const SCacheHeader*)map;
+	if (H->magic != CACHE_MAGIC || H->version != CACHE_VERSION || H->key != _Key
+	||	sizeof(SCacheHeader) + (size_t)H->bytes > (size_t)st.st_size) {
+		ERR("Cache_Open(%s): stale or truncated, ignored\n", path);
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	_File.map = map;
+	_File.map_size = st.st_size;
+	_Data.format = H->format;
+	_Data.freq = H->freq;
+	_Data.align = H->align;
+	_Data.loop_start = H->loop_start;
+	_Data.loop_end = H->loop_end;
+	_Data.data = H + 1;
+	_Data.bytes = H->bytes;
+	return true;
+}
+
+void Cache_Close(SCacheFile& _File)
+{
+	if (_File.map)
+		munmap(_File.map, _File.map_size);
+	memset(&_File, 0, sizeof(_File));
+}
+
+bool Cache_Store(uint64_t _Key, const SCacheData& _Data)
+{
+	if (!Cache_Enabled())
+		return false;
+
+	char path[320], tmp[352];
+	Cache_Path(path, sizeof(path), _Key);
+	snprintf(tmp, sizeof(tmp), "%s.%lu", path, SDL_ThreadID());
+
+	SCacheHeader H;
+	memset(&H, 0, sizeof(H));
+	H.magic = CACHE_MAGIC;
+	H.version = CACHE_VERSION;
+	H.key = _Key;
+	H.format = _Data.format;
+	H.freq = _Data.freq;
+	H.align = _Data.align;
+	H.loop_start = _Data.loop_start;
+	H.loop_end = _Data.loop_end;
+	H.bytes = _Data.bytes;
+
+	FILE* f = fopen(tmp, "wb");
+	if (f == NULL)
+		return false;
+	bool ok = fwrite(&H, sizeof(H), 1, f) == 1 && fwrite(_Data.data, _Data.bytes, 1, f) == 1;
+	ok = fclose(f) == 0 && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		ERR("Cache_Store(%s): write failed\n", path);
+		unlink(tmp);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+// Decoded sound cache: what LoadSound uploads after conversion, resampling or
+// encoding, kept on disk by content hash so warm starts upload straight from a mapping.
+//
+// layout:	SCacheHeader
+//			data
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_MAGIC		0x48434153		// "SACH"
+#define CACHE_VERSION	1				// bump when a conversion changes its output
+
+struct SCacheHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	key;
+	uint32_t	format;			// AL format of the data
+	uint32_t	freq;
+	uint32_t	align;			// ADPCM frames per block, 0 otherwise
+	uint32_t	loop_start;		// AL loop points, loop_end == 0: none
+	uint32_t	loop_end;
+	uint32_t	bytes;
+};
+
+// what goes to the AL buffer.
+struct SCacheData {
+	uint32_t	format;
+	uint32_t	freq;
+	uint32_t	align;
+	uint32_t	loop_start;
+	uint32_t	loop_end;
+	const void*	data;
+	uint32_t	bytes;
+};
+
+struct SCacheFile {
+	void*		map;
+	size_t		map_size;
+};
+
+bool		Cache_Init(const char* _Dir);		// created if missing
+void		Cache_Shutdown();
+bool		Cache_Enabled();
+
+// content hash of the source data mixed with the conversion settings, never 0.
+uint64_t	Cache_Key(const void* _Data, size_t _Size, uint64_t _Settings);
+
+// _Data points in the mapping until Cache_Close.
+bool		Cache_Open(uint64_t _Key, SCacheFile& _File, SCacheData& _Data);
+void		Cache_Close(SCacheFile& _File);
+
+// written aside then renamed, safe from several loader threads.
+bool		Cache_Store(uint64_t _Key, const SCacheData& _Data);
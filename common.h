@@ -0,0 +1,17 @@
+// shared helpers for the testbed modules
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define ERR(...)    fprintf(stderr, __VA_ARGS__)
+
+// FNV-1a, 0 is kept free to mark empty slots.
+static inline uint32_t HashName(const char* _Name)
+{
+	uint32_t h = 2166136261u;
+	for (const unsigned char* p = (const unsigned char*)_Name; *p; p++)
+		h = (h ^ *p) * 16777619u;
+	return h ? h : 1;
+}
@@ -2,6 +2,9 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <strings.h>
+#include <time.h>
+#include <dirent.h>
 
 #include <SDL.h>
 #include <SDL_opengl.h>
@@ -13,251 +16,2292 @@
 #include <imgui.h>
 #include "imgui_impl_sdl.h"
 
+#include "common.h"
+#include "sound.h"
+#include "bank.h"
+#include "stream.h"
+#include "watch.h"
+#include "cache.h"
+#include "ring.h"
+#include "audibility.h"
+
 //#define DResourcesRoot "./data/"
 #define DResourcesRoot "/home/shared/src/xbx/testbed-openal/data/"
+#define DResourcesPack DResourcesRoot "../data.pak"		// made with: testbed-pack data data.pak
+#define DResourcesCache DResourcesRoot "../cache/"		// decoded sounds, safe to delete
+#define DAudioRate 250		// Hz of the audio thread updates
+#define DMonoSources 256	// asked for, the device may give fewer
+#define DStereoSources 32
+#define DGroupBurst 1		// sound group of the burst test plays
+
+static const float PI = 3.14159f;
+
+static float FromDecibel(float dB)
+{
+	float Gain = exp10f(dB / 20.f);
+	return Gain < 0.0001f ? 0 : Gain;
+}
+
+static float ToDecibel(float gain)
+{
+	if (gain <= .001f) // -60dB
+		return -60.f;
+	else
+		return 20.f * log10f(gain);
+}
+
+// cpu time of the whole process, the OpenAL mixer thread included.
+static double ProcessCpuSeconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ------------------- Program resources -------------------------
+
+struct SResources
+{
+	SSound	mono;
+	SSound	stereo;
+	SSound	stereo_adpcm;	// same file, IMA4 in the AL buffer
+	SSound	monoloop;
+	SStream* stream_stereoloop;
+
+	SLoadStats load;		// summed over the loaded sounds
+	Uint64	load_start;		// when the loads were queued
+	double	load_wall;		// seconds until every sound settled, 0 while loading
+	int		reloads;		// hot reloaded files (audio thread)
+};
+
+static bool LoadResources(SResources& _Res)
+{
+	memset(&_Res, 0, sizeof(_Res));
+	_Res.load_start = SDL_GetPerformanceCounter();
+
+	// decoded in parallel on the loader threads, the UI comes up meanwhile.
+	// resampled to the mix rate there, voices then mix without resampling.
+	Loader_Load(_Res.mono, DResourcesRoot "sonar.wav", SOUND_RESAMPLE);
+	Loader_Load(_Res.stereo, DResourcesRoot "bark.wav", SOUND_RESAMPLE);
+	Loader_Load(_Res.stereo_adpcm, DResourcesRoot "bark.wav", SOUND_RESAMPLE|SOUND_ADPCM);
+	Loader_Load(_Res.monoloop, DResourcesRoot "mosquitoloop.wav", SOUND_RESAMPLE);
+
+	// long ambience beds are streamed instead of fully resident.
+	_Res.stream_stereoloop = Stream_Open(DResourcesRoot "rainloop.wav", true);
+	if (_Res.stream_stereoloop == NULL)
+		return false;
+
+	return true;
+}
+
+static int ResourcesSounds(SResources& _Res, SSound* _Sounds[])
+{
+	int c = 0;
+	_Sounds[c++] = &_Res.mono;
+	_Sounds[c++] = &_Res.stereo;
+	_Sounds[c++] = &_Res.stereo_adpcm;
+	_Sounds[c++] = &_Res.monoloop;
+	return c;
+}
+
+// a file of the data directory changed: decoded again on the loader threads,
+// the streams pick it up at their next loop. (audio thread)
+static void ReloadResources(SResources& _Res, const char* _Name)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s%s", DResourcesRoot, _Name);
+
+	SSound* Sounds[8];
+	int cSounds = ResourcesSounds(_Res, Sounds);
+	for (int i = 0; i < cSounds; i++) {
+		if (strcmp(Sounds[i]->path, path) == 0 && Loader_Reload(*Sounds[i]))
+			_Res.reloads++;
+	}
+	if (Bank_Reload(_Name))
+		_Res.reloads++;
+	if (_Res.stream_stereoloop && strcmp(Stream_Path(_Res.stream_stereoloop), path) == 0) {
+		Stream_Reload(_Res.stream_stereoloop);
+		_Res.reloads++;
+	}
+}
+
+// reloaded sounds replace the current ones. (audio thread)
+static void SwapResources(SResources& _Res)
+{
+	SSound* Sounds[8];
+	int cSounds = ResourcesSounds(_Res, Sounds);
+	for (int i = 0; i < cSounds; i++)
+		Loader_Swap(*Sounds[i]);
+}
+
+static void UpdateResources(SResources& _Res)
+{
+	SSound* Sounds[8];
+	int cSounds = ResourcesSounds(_Res, Sounds);
+	if (_Res.load_wall > 0)
+		return;
+
+	SLoadStats load = { 0, 0, 0 };
+	for (int i = 0; i < cSounds; i++) {
+		int state = Sound_State(*Sounds[i]);
+		if (state != SOUND_READY && state != SOUND_FAILED)
+			return;
+		load.bytes += Sounds[i]->load.bytes;
+		load.seconds += Sounds[i]->load.seconds;
+		load.cached += Sounds[i]->load.cached;
+	}
+	_Res.load = load;
+	_Res.load_wall = (double)(SDL_GetPerformanceCounter() - _Res.load_start) / SDL_GetPerformanceFrequency();
+}
+
+// every wav of the data directory goes to the bank, loaded when first played.
+static int ScanBank(const char* _Root)
+{
+	DIR* dir = opendir(_Root);
+	if (dir == NULL)
+		return 0;
+	int c = 0;
+	while (dirent* e = readdir(dir)) {
+		const char* ext = strrchr(e->d_name, '.');
+		if (ext && strcasecmp(ext, ".wav") == 0 && Bank_Sound(e->d_name))
+			c++;
+	}
+	closedir(dir);
+	return c;
+}
+
+static void FreeResources(SResources& _Res)
+{
+	// (loader threads stopped)
+	Loader_Free(_Res.mono);
+	Loader_Free(_Res.stereo);
+	Loader_Free(_Res.stereo_adpcm);
+	Loader_Free(_Res.monoloop);
+	Stream_Close(_Res.stream_stereoloop);	_Res.stream_stereoloop = NULL;
+}
+
+
+// ------------------- OpenAl sources manager -------------------------
+#define MGR_MAX_SOURCES 1024		// per pool, whatever the device offers
+#define MGR_DEFAULT_SOURCES 32		// per pool, when the device tells nothing
+#define MGR_MIN_EMITTERS 256		// emitter storage grows from there (multiple of AUDIBILITY_LANES)
+#define MGR_EMITTER_SOURCES 16		// at most, taken from the mono sources
+#define MGR_VIRTUAL_HYSTERESIS 1.5f	// bound emitters stay until another is this much louder
+#define MGR_LOD_PAN_DB -24.f		// bound emitters quieter than that at the listener lose doppler
+#define MGR_LOD_CENTER_DB -36.f		// and then their direction
+#define MGR_LOD_HYSTERESIS_DB 3.f	// tiers are left that far past their bounds
+#define MGR_EXTRAPOLATE_MS 100		// positions carried along their velocity for that long at most
+#define MGR_END_MARGIN_MS 20		// one shots are polled from this close to their expected end
+#define MGR_MAX_EVENTS 256
+
+#ifndef AL_SOFT_source_start_delay
+typedef void (AL_APIENTRY*LPALSOURCEPLAYATTIMESOFT)(ALuint, ALint64SOFT);
+#endif
+
+// AL calls of the manager, counted per update.
+static int s_cALCalls = 0;
+#define MGR_AL(_Call)	(s_cALCalls++, _Call)
+#define MGR_MAX_PENDING 256		// loading, waiting for a stolen voice, or scheduled
+#define MGR_SCHEDULE_AHEAD_MS 100	// scheduled plays get their source that early with AL_SOFT_source_start_delay
+#define MGR_PENDING_TIMEOUT_MS 500
+#define MGR_STEAL_FADE_MS 40		// stolen and stopped voices
+#define MGR_START_FADE_MS 10		// emitters started
+#define MGR_STEAL_HORIZON 1.f		// seconds, voices ending sooner count as less audible
+#define MGR_MAX_INSTANCES 4096		// handle slots, power of 2
+#define MGR_HANDLE_SLOT_BITS 12		// log2(MGR_MAX_INSTANCES), the generation above
+#define MGR_MAX_GROUPS 16			// 0: no limit
+#define MGR_GRID_CELL 16.f			// meters
+#define MGR_GRID_BUCKETS 4096		// cells hashed into, power of 2
+#define MGR_AUDIBLE_DISTANCE 64.f	// emitters in cells farther from the listener are not scored
+#define MGR_GRID_NONE (~(Uint64)0)		// not in the grid yet
+#define MGR_GRID_DIRECT (~(Uint64)1)	// direct emitters, heard anywhere
+
+enum EEmitterDirty {
+	EMITTER_DIRTY_GAIN		= 1<<0,
+	EMITTER_DIRTY_RADIUS	= 1<<1,
+	EMITTER_DIRTY_POSITION	= 1<<2,
+	EMITTER_DIRTY_VELOCITY	= 1<<3,
+	EMITTER_DIRTY_LOD		= 1<<4,
+	EMITTER_DIRTY_ALL		= 0x1F,
+};
+
+// what a bound emitter keeps of its spatial rendering, from what reaches the listener. the farthest are virtual.
+// (OpenAL Soft turns HRTF on for the whole device and has no per source bus: there is no HRTF / panning /
+// shared downmix split here, the tiers only drop doppler then the direction. the mixer still mixes every source.)
+enum EMgrLod {
+	MGR_LOD_FULL,			// spatialized (HRTF when the device has it), doppler
+	MGR_LOD_PAN,			// spatialized, no doppler and the linear resampler
+	MGR_LOD_CENTER,			// not spatialized: at a fixed direction, still attenuated (without AL_SOFT_source_spatialize, as MGR_LOD_PAN)
+	MGR_LOD_COUNT,
+};
+
+// one shot sources by buffer format: ALC_MONO_SOURCES and ALC_STEREO_SOURCES are separate budgets.
+enum EMgrPool {
+	MGR_POOL_MONO,
+	MGR_POOL_STEREO,		// streamed emitters too
+	MGR_POOL_COUNT,
+};
+
+enum EMgrCurve {
+	MGR_CURVE_LINEAR,
+	MGR_CURVE_EXP,			// constant dB per ms, from -60 dB for silence
+};
+
+// a gain envelope, evaluated at the audio thread updates.
+struct SMgrRamp {
+	float	from;
+	float	to;
+	Uint32	start;		// SDL_GetTicks
+	Uint32	ms;			// 0: reached
+	int		curve;		// EMgrCurve
+};
+
+enum EMgrPriority {
+	MGR_PRIORITY_LOW,
+	MGR_PRIORITY_NORMAL,
+	MGR_PRIORITY_HIGH,		// only stolen by other high priority plays
+};
+
+struct SEmitter {
+	ALuint Source;		// 0: virtual, the playback position advances in cursor
+	bool  active;
+	bool  loop;
+	bool  direct;
+	float dB;
+	const SSound* sound;	// bound to the source once loaded
+	ALuint bound;		// != sound->buffer: reloaded, rebound at the next loop
+	ALint offset;		// sample offset last frame to spot the loop, -1: not yet
+	SStream* stream;	// != NULL: the source queue is fed by the stream thread, never virtual
+
+	// virtual playback, from the buffer last measured
+	double cursor;		// frames
+	ALuint measured;
+	int    freq;
+	Uint32 frames;
+	Uint32 loop_start;
+	Uint32 loop_end;	// 0: whole buffer
+	bool   audible;		// among the most audible, during the selection
+
+	// spatial, the position is in SEmitterHot
+	float radius;
+	float vel[3];
+	Uint32 moved;		// SEmitterParams::time
+	int   lod;			// EMgrLod, while bound
+
+	// what the source has, only changed fields are sent
+	int    dirty;		// EEmitterDirty sent regardless, set when bound
+	float  gain;		// FromDecibel(gain_dB), the target of ramp
+	float  gain_dB;
+	SMgrRamp ramp;		// to gain, or 0 when stopping
+	bool   stopping;	// inactive, keeps its source until faded out
+	float  sent_gain;
+	float  sent_radius;
+	float  sent_pos[3];
+	float  sent_vel[3];
+	bool   playing;		// last known source state
+};
+
+// what the selection reads of every emitter each update, scored in one pass (audibility.h).
+// kept by the setters: gain is 0 for emitters not candidates.
+// the arrays share one 32 bytes aligned block, x first.
+struct SEmitterHot {
+	float*	x;
+	float*	y;
+	float*	z;
+	float*	gain;		// Mgr_EmitterGain
+	float*	rolloff;	// 0: direct
+	float*	bias;		// MGR_VIRTUAL_HYSTERESIS when bound
+	float*	score;
+};
+#define MGR_HOT_ARRAYS 7
+
+// emitters by cell, in a chain per hash bucket (index+1, 0: end). moved when their cell changes.
+struct SEmitterGrid {
+	int		Buckets[MGR_GRID_BUCKETS];
+	int		Direct;
+	int*	Next;
+	int*	Prev;
+	Uint64*	Cells;		// key of the cell each emitter is in
+	int*	Near;		int cNear;		// queried, Scored holds their fields
+};
+
+// emitter indices in no order, each emitter knowing its place. kept by Mgr_SyncHot,
+// the update then walks the few emitters concerned instead of all of them.
+struct SEmitterList {
+	int*	Items;		int cItems;
+	int*	At;			// by emitter, -1: not in
+};
+
+// a source stopped, from the AL event thread.
+struct SMgrEvent {
+	ALuint	source;
+	Uint64	time;		// SDL_GetPerformanceCounter
+};
+
+// what the game side changes on an emitter.
+struct SEmitterParams {
+	float	dB;
+	Uint32	ramp;		// ms to reach dB
+	int		curve;		// EMgrCurve
+	float	radius;
+	float	pos[3];
+	float	vel[3];
+	Uint32	time;		// SDL_GetTicks of pos, then moved along vel until sent. 0: pos as is
+	bool	active;
+};
+
+// a one shot: its slot in the low bits, the generation of the slot above. 0: none.
+// handles stay valid while the sound plays, then every operation on them does nothing.
+// slots are taken by the thread making the handles (Audio_PushPlay), given back through Released.
+typedef Uint32 HMgrSound;
+
+// where the one shot of a handle is, in Pending or Active.
+// a play coalesced into another gets an alias of it, given back with it.
+struct SMgrInstance {
+	HMgrSound	handle;		// 0: free
+	int			index;
+	bool		pending;
+	HMgrSound	target;		// an alias: the handle of the play joined, 0: none
+	int			next;		// slot+1 of the next alias of this play, 0: end
+};
+
+// a play request, deferred while its sound is still loading or a stolen voice fades out.
+struct SMgrPlay {
+	HMgrSound handle;
+	const SSound* sound;
+	float	dB;
+	bool	direct;
+	float	pos[3];
+	float	radius;
+	int		priority;	// EMgrPriority
+	int		group;		// SMgrGroup
+	Sint64	at;			// start on the device clock, ns (Mgr_Clock), 0: now
+	Uint32	time;		// queued, then started at
+	bool	stole;		// a voice fades out for it
+};
+
+// plays of a group: at most max instances, the same sound again within the window joins the voice.
+struct SMgrGroup {
+	int		max;		// 0: no limit
+	Uint32	window;		// ms, 0: never coalesced
+	int		cCoalesced;
+	int		cLimited;	// oldest instance stopped
+};
+
+struct SMgrPool {
+	ALuint*		Avail;		int cAvail;
+	int			cSources;
+};
+
+// sized in Mgr_Init from the device, the emitters grow with Mgr_AddEmitter.
+struct SMgrState {
+	SMgrPool	Pools[MGR_POOL_COUNT];
+	ALuint*		Active;			int cActive;
+	int*		ActivePools;	// EMgrPool
+	SMgrPlay*	ActivePlays;	// sounds held in the bank while playing
+	ALuint*		ActiveBuffers;	// (kept alive across reloads)
+	Uint32*		ActiveFades;	// stolen at, 0: not fading
+	SMgrRamp*	ActiveRamps;	// gain
+	Uint32*		ActiveEnds;		// expected end, SDL_GetTicks
+	ALuint*		InUse;			// Loader_Collect scratch
+	ALuint*		SourceKeys;		// the one shot sources, open addressing on the name (Mgr_SourceSlot)
+	int*		ActiveOf;		// by SourceKeys slot: index in Active, -1: available
+	Uint32		SourceMask;
+	SMgrPlay	Pending[MGR_MAX_PENDING];	int cPending;
+	SMgrInstance Instances[MGR_MAX_INSTANCES];		// by handle slot
+	SRing		Released;		// Uint16 handle slots free again, to the thread making the handles
+	SMgrGroup	Groups[MGR_MAX_GROUPS];
+	int			cStolen;
+	int			cDropped;
+
+	SEmitter*	Emitters;		int cEmitters;		int capEmitters;
+	SEmitterHot	Hot;
+	SEmitterGrid Grid;
+	SEmitterHot	Scored;			// the emitters near the listener, gathered from Hot
+	SEmitterList Bound;			// with a source, streams too
+	SEmitterList Virtual;		// active without a source
+	float		ScoreUs;		// grid query and Audibility_Score, last update
+	ALuint		Voices[MGR_EMITTER_SOURCES];		int cVoices;	// emitter sources not bound
+	int			nVoices;
+	int			cVirtual;		// of Virtual, the loaded ones advancing
+	Uint32		Time;			// last update, SDL_GetTicks
+	bool		LoopPoints;		// AL_SOFT_loop_points
+	bool		Spatialize;		// AL_SOFT_source_spatialize
+
+	// AL_SOFT_deferred_updates, NULL without
+	LPALDEFERUPDATESSOFT	alDeferUpdatesSOFT;
+	LPALPROCESSUPDATESSOFT	alProcessUpdatesSOFT;
+	bool		Dirty;			// dirty tracking, else every parameter and state each update
+	int			cALCalls;		// since the previous update
+
+	// AL_SOFT_events, Events.data == NULL without: finished one shots are polled.
+	LPALEVENTCALLBACKSOFT	alEventCallbackSOFT;
+	SRing		Events;			// SMgrEvent
+	SDL_atomic_t EventsLost;	// the ring overflowed, polled once
+	int			cRecycled;		// through events
+	float		RecycleDelay;	// ms from the source stop, averaged
+
+	// ALC_SOFT_device_clock and AL_SOFT_source_start_delay, NULL without:
+	// the clock is then SDL_GetPerformanceCounter, scheduled plays start at the first update past their time.
+	ALCdevice*				Device;
+	LPALCGETINTEGER64VSOFT	alcGetInteger64vSOFT;
+	LPALSOURCEPLAYATTIMESOFT alSourcePlayAtTimeSOFT;
+
+	// AL_SOFT_source_resampler, -1 without
+	int			MixFreq;
+	ALint		ResamplerDefault;
+	ALint		ResamplerFast;		// for buffers already at the mix rate
+};
+
+// ------------------- envelopes -------------------------
+// the gain at _Now, the ramp is marked reached after.
+static float Mgr_Ramp(SMgrRamp& _R, Uint32 _Now)
+{
+	if (_R.ms == 0)
+		return _R.to;
+	const Sint32 t = (Sint32)(_Now - _R.start);
+	if (t <= 0)
+		return _R.from;
+	if ((Uint32)t >= _R.ms) {
+		_R.ms = 0;
+		return _R.to;
+	}
+	const float x = (float)t / _R.ms;
+	if (_R.curve == MGR_CURVE_EXP) {
+		const float a = _R.from > .001f ? _R.from : .001f;
+		const float b = _R.to > .001f ? _R.to : .001f;
+		return a * powf(b / a, x);
+	}
+	return _R.from + (_R.to - _R.from) * x;
+}
+
+// from where the ramp is now.
+static void Mgr_RampTo(SMgrRamp& _R, float _To, Uint32 _Ms, int _Curve, Uint32 _Now)
+{
+	_R.from = Mgr_Ramp(_R, _Now);
+	_R.to = _To;
+	_R.start = _Now;
+	_R.ms = _Ms;
+	_R.curve = _Curve;
+}
+
+// AL event thread: stopped sources go to the manager, that checks they are still its one shots.
+static void AL_APIENTRY Mgr_OnEvent(ALenum _Type, ALuint _Object, ALuint _Param, ALsizei, const ALchar*, void* _User)
+{
+	if (_Type != AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT || _Param != AL_STOPPED)
+		return;
+	SMgrState& State = *(SMgrState*)_User;
+	SMgrEvent E = { _Object, SDL_GetPerformanceCounter() };
+	if (!Ring_Push(State.Events, &E))
+		SDL_AtomicSet(&State.EventsLost, 1);
+}
+
+// the SourceKeys slot of a one shot source, -1 for others. the keys are set once in Mgr_Init.
+static int Mgr_SourceSlot(const SMgrState& _State, ALuint _Source)
+{
+	Uint32 i = (_Source * 2654435761u) & _State.SourceMask;
+	while (_State.SourceKeys[i] != _Source) {
+		if (_State.SourceKeys[i] == 0)
+			return -1;
+		i = (i+1) & _State.SourceMask;
+	}
+	return i;
+}
+
+// as many as the device gives, up to _Count.
+static int Mgr_GenSources(ALuint* _Sources, int _Count)
+{
+	// (not alGetError: the loader threads share the context error state)
+	int n = 0;
+	for (; n < _Count; n++) {
+		_Sources[n] = 0;
+		alGenSources(1, _Sources + n);
+		if (_Sources[n] == 0 || !alIsSource(_Sources[n]))
+			break;
+	}
+	return n;
+}
+
+static int Mgr_Pool(ALuint _Buffer)
+{
+	ALint channels = 1;
+	MGR_AL(alGetBufferi(_Buffer, AL_CHANNELS, &channels));
+	return channels > 1 ? MGR_POOL_STEREO : MGR_POOL_MONO;
+}
+
+// the pools take what the context was given: the emitter sources from the mono ones,
+// the rest for one shots.
+static void Mgr_Init(SMgrState& _State, ALCdevice* _Device)
+{
+	memset(&_State, 0, sizeof(_State));
+	ALCint cMono = 0, cStereo = 0;
+	alcGetIntegerv(_Device, ALC_MONO_SOURCES, 1, &cMono);
+	alcGetIntegerv(_Device, ALC_STEREO_SOURCES, 1, &cStereo);
+	if (cMono <= 0)
+		cMono = MGR_DEFAULT_SOURCES + MGR_EMITTER_SOURCES;
+	if (cStereo <= 0)
+		cStereo = MGR_DEFAULT_SOURCES;
+
+	_State.nVoices = _State.cVoices = Mgr_GenSources(_State.Voices, SDL_min(MGR_EMITTER_SOURCES, cMono/2));
+	const int want[MGR_POOL_COUNT] = { SDL_min(cMono - _State.nVoices, MGR_MAX_SOURCES), SDL_min(cStereo, MGR_MAX_SOURCES) };
+	int cOneShots = 0;
+	for (int p = 0; p < MGR_POOL_COUNT; p++) {
+		SMgrPool& P = _State.Pools[p];
+		P.Avail = (ALuint*)malloc(want[p] * sizeof(ALuint));
+		P.cSources = P.cAvail = Mgr_GenSources(P.Avail, want[p]);
+		cOneShots += P.cSources;
+	}
+	_State.Active = (ALuint*)malloc(cOneShots * sizeof(ALuint));
+	_State.ActivePools = (int*)malloc(cOneShots * sizeof(int));
+	_State.ActivePlays = (SMgrPlay*)malloc(cOneShots * sizeof(SMgrPlay));
+	_State.ActiveBuffers = (ALuint*)malloc(cOneShots * sizeof(ALuint));
+	_State.ActiveFades = (Uint32*)malloc(cOneShots * sizeof(Uint32));
+	_State.ActiveRamps = (SMgrRamp*)malloc(cOneShots * sizeof(SMgrRamp));
+	_State.ActiveEnds = (Uint32*)malloc(cOneShots * sizeof(Uint32));
+	_State.InUse = (ALuint*)malloc((cOneShots + _State.nVoices) * sizeof(ALuint));
+	Ring_Init(_State.Released, sizeof(Uint16), MGR_MAX_INSTANCES);
+
+	// finished sources reported by events are found in Active through there.
+	Uint32 cSlots = 2;
+	while (cSlots < 2 * (Uint32)cOneShots)
+		cSlots *= 2;
+	_State.SourceMask = cSlots - 1;
+	_State.SourceKeys = (ALuint*)calloc(cSlots, sizeof(ALuint));
+	_State.ActiveOf = (int*)malloc(cSlots * sizeof(int));
+	for (int p = 0; p < MGR_POOL_COUNT; p++) {
+		for (int k = 0; k < _State.Pools[p].cSources; k++) {
+			const ALuint s = _State.Pools[p].Avail[k];
+			Uint32 i = (s * 2654435761u) & _State.SourceMask;
+			while (_State.SourceKeys[i] != 0)
+				i = (i+1) & _State.SourceMask;
+			_State.SourceKeys[i] = s;
+			_State.ActiveOf[i] = -1;
+		}
+	}
+
+	_State.MixFreq = Sound_DeviceFreq();
+	_State.ResamplerDefault = _State.ResamplerFast = -1;
+	if (alIsExtensionPresent("AL_SOFT_source_resampler")) {
+		LPALGETSTRINGISOFT alGetStringiSOFT = (LPALGETSTRINGISOFT)alGetProcAddress("alGetStringiSOFT");
+		_State.ResamplerDefault = _State.ResamplerFast = alGetInteger(AL_DEFAULT_RESAMPLER_SOFT);
+		int cResamplers = alGetInteger(AL_NUM_RESAMPLERS_SOFT);
+		for (int i = 0; alGetStringiSOFT && i < cResamplers; i++) {
+			if (strcasecmp(alGetStringiSOFT(AL_RESAMPLER_NAME_SOFT, i), "Linear") == 0)
+				_State.ResamplerFast = i;
+		}
+	}
+
+	_State.Device = _Device;
+	if (alcIsExtensionPresent(_Device, "ALC_SOFT_device_clock")) {
+		_State.alcGetInteger64vSOFT = (LPALCGETINTEGER64VSOFT)alcGetProcAddress(_Device, "alcGetInteger64vSOFT");
+		// (start times are on the device clock)
+		if (_State.alcGetInteger64vSOFT && alIsExtensionPresent("AL_SOFT_source_start_delay"))
+			_State.alSourcePlayAtTimeSOFT = (LPALSOURCEPLAYATTIMESOFT)alGetProcAddress("alSourcePlayAtTimeSOFT");
+	}
+
+	_State.LoopPoints = alIsExtensionPresent("AL_SOFT_loop_points");
+	_State.Spatialize = alIsExtensionPresent("AL_SOFT_source_spatialize");
+	_State.Dirty = true;
+	if (alIsExtensionPresent("AL_SOFT_deferred_updates")) {
+		_State.alDeferUpdatesSOFT = (LPALDEFERUPDATESSOFT)alGetProcAddress("alDeferUpdatesSOFT");
+		_State.alProcessUpdatesSOFT = (LPALPROCESSUPDATESSOFT)alGetProcAddress("alProcessUpdatesSOFT");
+		if (!_State.alDeferUpdatesSOFT || !_State.alProcessUpdatesSOFT)
+			_State.alDeferUpdatesSOFT = NULL;
+	}
+
+	if (alIsExtensionPresent("AL_SOFT_events")) {
+		LPALEVENTCONTROLSOFT alEventControlSOFT = (LPALEVENTCONTROLSOFT)alGetProcAddress("alEventControlSOFT");
+		_State.alEventCallbackSOFT = (LPALEVENTCALLBACKSOFT)alGetProcAddress("alEventCallbackSOFT");
+		if (alEventControlSOFT && _State.alEventCallbackSOFT && Ring_Init(_State.Events, sizeof(SMgrEvent), MGR_MAX_EVENTS)) {
+			const ALenum type = AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT;
+			_State.alEventCallbackSOFT(Mgr_OnEvent, &_State);
+			alEventControlSOFT(1, &type, AL_TRUE);
+		} else {
+			_State.alEventCallbackSOFT = NULL;
+		}
+	}
+}
+
+static void Mgr_Destroy(SMgrState& _State)
+{
+	for (int i = 0; i < _State.cPending; i++)
+		Bank_Release(*_State.Pending[i].sound);
+	_State.cPending = 0;
+	for (int i = 0; i < _State.cActive; i++)
+		Bank_Release(*_State.ActivePlays[i].sound);
+	if (_State.cActive > 0)
+		alSourceStopv(_State.cActive, _State.Active);
+	for (int i = 0; i < _State.cActive; i++) {
+		SMgrPool& P = _State.Pools[_State.ActivePools[i]];
+		P.Avail[P.cAvail] = _State.Active[i];	P.cAvail++;
+	}
+	_State.cActive = 0;
+	for (int i=0; i < _State.cEmitters; i++) {
+		SEmitter& E = _State.Emitters[i];
+		if (E.sound)
+			Bank_Release(*E.sound);
+		if (E.Source == 0)
+			continue;
+		alSourceStop(E.Source);
+		if (E.stream) {
+			Stream_Attach(E.stream, 0);
+			SMgrPool& P = _State.Pools[MGR_POOL_STEREO];
+			P.Avail[P.cAvail] = E.Source;	P.cAvail++;
+		} else {
+			_State.Voices[_State.cVoices] = E.Source;	_State.cVoices ++;
+		}
+		E.Source = 0;
+	}
+	_State.cEmitters = 0;
+	if (_State.alEventCallbackSOFT) {
+		_State.alEventCallbackSOFT(NULL, NULL);
+		_State.alEventCallbackSOFT = NULL;
+		Ring_Free(_State.Events);
+	}
+	for (int p = 0; p < MGR_POOL_COUNT; p++) {
+		alDeleteSources(_State.Pools[p].cAvail, _State.Pools[p].Avail);
+		free(_State.Pools[p].Avail);
+	}
+	alDeleteSources(_State.cVoices, _State.Voices);
+	free(_State.Active);
+	free(_State.ActivePools);
+	free(_State.ActivePlays);
+	free(_State.ActiveBuffers);
+	free(_State.ActiveFades);
+	free(_State.ActiveRamps);
+	free(_State.ActiveEnds);
+	free(_State.InUse);
+	Ring_Free(_State.Released);
+	free(_State.SourceKeys);
+	free(_State.ActiveOf);
+	free(_State.Emitters);
+	free(_State.Hot.x);
+	free(_State.Scored.x);
+	free(_State.Grid.Next);
+	free(_State.Grid.Prev);
+	free(_State.Grid.Cells);
+	free(_State.Grid.Near);
+	free(_State.Bound.Items);
+	free(_State.Bound.At);
+	free(_State.Virtual.Items);
+	free(_State.Virtual.At);
+	memset(&_State, 0, sizeof(_State));
+}
+
+static float Mgr_EmitterGain(SEmitter& _E)
+{
+	if (_E.dB != _E.gain_dB) {
+		_E.gain_dB = _E.dB;
+		_E.gain = FromDecibel(_E.dB);
+	}
+	return _E.gain;
+}
+
+// ------------------- spatial grid -------------------------
+static int Mgr_GridCoord(float _X)
+{
+	return (int)floorf(_X * (1.f / MGR_GRID_CELL));
+}
+
+static Uint64 Mgr_GridKey(int _X, int _Y, int _Z)
+{
+	return ((Uint64)(_X & 0x1FFFFF) << 42) | ((Uint64)(_Y & 0x1FFFFF) << 21) | (Uint64)(_Z & 0x1FFFFF);
+}
+
+static int& Mgr_GridHead(SEmitterGrid& _Grid, Uint64 _Key)
+{
+	if (_Key == MGR_GRID_DIRECT)
+		return _Grid.Direct;
+	return _Grid.Buckets[(_Key * 0x9E3779B97F4A7C15ull) >> 52 & (MGR_GRID_BUCKETS-1)];
+}
+
+// into the cell of its position, when it changed.
+static void Mgr_Place(SMgrState& _State, int _Index)
+{
+	SEmitterGrid& G = _State.Grid;
+	const SEmitterHot& H = _State.Hot;
+	const Uint64 key = _State.Emitters[_Index].direct ? MGR_GRID_DIRECT :
+		Mgr_GridKey(Mgr_GridCoord(H.x[_Index]), Mgr_GridCoord(H.y[_Index]), Mgr_GridCoord(H.z[_Index]));
+	if (key == G.Cells[_Index])
+		return;
+
+	if (G.Cells[_Index] != MGR_GRID_NONE) {
+		const int next = G.Next[_Index], prev = G.Prev[_Index];
+		if (prev)
+			G.Next[prev-1] = next;
+		else
+			Mgr_GridHead(G, G.Cells[_Index]) = next;
+		if (next)
+			G.Prev[next-1] = prev;
+	}
+	int& head = Mgr_GridHead(G, key);
+	G.Next[_Index] = head;
+	G.Prev[_Index] = 0;
+	if (head)
+		G.Prev[head-1] = _Index+1;
+	head = _Index+1;
+	G.Cells[_Index] = key;
+}
+
+static void Mgr_Gather(SMgrState& _State, int _Head, Uint64 _Key)
+{
+	SEmitterGrid& G = _State.Grid;
+	const SEmitterHot& H = _State.Hot;
+	SEmitterHot& S = _State.Scored;
+	for (int e = _Head; e; e = G.Next[e-1]) {
+		const int i = e-1;
+		// (other cells in the same bucket are gathered with their own)
+		if (G.Cells[i] != _Key || H.gain[i] <= 0.f)
+			continue;
+		const int n = G.cNear++;
+		G.Near[n] = i;
+		S.x[n] = H.x[i];
+		S.y[n] = H.y[i];
+		S.z[n] = H.z[i];
+		S.gain[n] = H.gain[i];
+		S.rolloff[n] = H.rolloff[i];
+		S.bias[n] = H.bias[i];
+	}
+}
+
+// the candidates in the cells within MGR_AUDIBLE_DISTANCE of the listener, and the direct ones,
+// into Near and Scored padded to AUDIBILITY_LANES. the cost follows the emitters around, not their total.
+static int Mgr_Query(SMgrState& _State, const float _Listener[3])
+{
+	SEmitterGrid& G = _State.Grid;
+	G.cNear = 0;
+	Mgr_Gather(_State, G.Direct, MGR_GRID_DIRECT);
+
+	int lo[3], hi[3];
+	for (int a = 0; a < 3; a++) {
+		lo[a] = Mgr_GridCoord(_Listener[a] - MGR_AUDIBLE_DISTANCE);
+		hi[a] = Mgr_GridCoord(_Listener[a] + MGR_AUDIBLE_DISTANCE);
+	}
+	for (int x = lo[0]; x <= hi[0]; x++)
+		for (int y = lo[1]; y <= hi[1]; y++)
+			for (int z = lo[2]; z <= hi[2]; z++) {
+				const Uint64 key = Mgr_GridKey(x, y, z);
+				Mgr_Gather(_State, Mgr_GridHead(G, key), key);
+			}
+
+	for (int n = G.cNear; n % AUDIBILITY_LANES != 0; n++)
+		_State.Scored.gain[n] = 0.f;
+	return G.cNear;
+}
+
+static void Mgr_List(SEmitterList& _List, int _Index, bool _In)
+{
+	const int at = _List.At[_Index];
+	if (_In && at < 0) {
+		_List.At[_Index] = _List.cItems;
+		_List.Items[_List.cItems] = _Index;	_List.cItems++;
+	} else if (!_In && at >= 0) {
+		const int last = _List.Items[_List.cItems-1];	_List.cItems--;
+		_List.Items[at] = last;
+		_List.At[last] = at;
+		_List.At[_Index] = -1;
+	}
+}
+
+// the scored fields and the lists of an emitter, after its setters.
+static void Mgr_SyncHot(SMgrState& _State, const SEmitter& _E)
+{
+	const int i = &_E - _State.Emitters;
+	SEmitterHot& H = _State.Hot;
+	H.gain[i] = (_E.active || _E.stopping) && !_E.stream ? Mgr_EmitterGain(_State.Emitters[i]) : 0.f;
+	H.rolloff[i] = _E.direct ? 0.f : 1.f;
+	H.bias[i] = _E.Source ? MGR_VIRTUAL_HYSTERESIS : 1.f;
+	Mgr_Place(_State, i);
+	Mgr_List(_State.Bound, i, _E.Source != 0);
+	Mgr_List(_State.Virtual, i, _E.Source == 0 && _E.active);
+}
+
+
+// a new aligned block for the arrays, the first _Count of each moved over.
+static bool Mgr_AllocHot(SEmitterHot& _Hot, int _Capacity, int _Count)
+{
+	void* block = NULL;
+	if (posix_memalign(&block, 32, MGR_HOT_ARRAYS * _Capacity * sizeof(float)) != 0)
+		return false;
+	float** arrays[MGR_HOT_ARRAYS] = { &_Hot.x, &_Hot.y, &_Hot.z, &_Hot.gain, &_Hot.rolloff, &_Hot.bias, &_Hot.score };
+	float* old = _Hot.x;
+	for (int a = 0; a < MGR_HOT_ARRAYS; a++) {
+		float* array = (float*)block + a * _Capacity;
+		if (_Count > 0)
+			memcpy(array, *arrays[a], _Count * sizeof(float));
+		memset(array + _Count, 0, (_Capacity - _Count) * sizeof(float));
+		*arrays[a] = array;
+	}
+	free(old);
+	return true;
+}
+
+// twice the room for the emitters and their fields. (SEmitter pointers are stale after)
+static bool Mgr_GrowEmitters(SMgrState& _State)
+{
+	const int cap = _State.capEmitters ? _State.capEmitters * 2 : MGR_MIN_EMITTERS;
+	SEmitter* emitters = (SEmitter*)realloc(_State.Emitters, cap * sizeof(SEmitter));
+	if (emitters == NULL)
+		return false;
+	_State.Emitters = emitters;
+
+	SEmitterGrid& G = _State.Grid;
+	int* next = (int*)realloc(G.Next, cap * sizeof(int));		if (next) G.Next = next;
+	int* prev = (int*)realloc(G.Prev, cap * sizeof(int));		if (prev) G.Prev = prev;
+	Uint64* cells = (Uint64*)realloc(G.Cells, cap * sizeof(Uint64));	if (cells) G.Cells = cells;
+	int* near = (int*)realloc(G.Near, cap * sizeof(int));		if (near) G.Near = near;
+	if (!next || !prev || !cells || !near)
+		return false;
+	SEmitterList* lists[2] = { &_State.Bound, &_State.Virtual };
+	for (int l = 0; l < 2; l++) {
+		int* items = (int*)realloc(lists[l]->Items, cap * sizeof(int));	if (items) lists[l]->Items = items;
+		int* at = (int*)realloc(lists[l]->At, cap * sizeof(int));		if (at) lists[l]->At = at;
+		if (!items || !at)
+			return false;
+	}
+	// (scored arrays are filled each update)
+	if (!Mgr_AllocHot(_State.Hot, cap, _State.cEmitters) || !Mgr_AllocHot(_State.Scored, cap, 0))
+		return false;
+	_State.capEmitters = cap;
+	return true;
+}
+
+// inactive and virtual until it becomes one of the most audible.
+// the returned pointer is valid until the next emitter is added.
+static SEmitter* Mgr_AddEmitter(SMgrState& _State)
+{
+	if (_State.cEmitters == _State.capEmitters && !Mgr_GrowEmitters(_State)) {
+		ERR("Too many emitters\n");
+		return NULL;
+	}
+	SEmitter& E = _State.Emitters[_State.cEmitters];	_State.cEmitters++;
+	memset(&E, 0, sizeof(E));
+	E.offset = -1;
+	E.gain = 1.f;
+	const int i = _State.cEmitters-1;
+	_State.Hot.x[i] = _State.Hot.y[i] = _State.Hot.z[i] = 0.f;
+	_State.Grid.Cells[i] = MGR_GRID_NONE;
+	_State.Bound.At[i] = _State.Virtual.At[i] = -1;
+	Mgr_SyncHot(_State, E);
+	return &E;
+}
+
+// only pitch and doppler still resample buffers at the mix rate, linear is enough there.
+static void Mgr_SetResampler(const SMgrState& _State, ALuint _Source, ALuint _Buffer)
+{
+	if (_State.ResamplerDefault < 0)
+		return;
+	ALint freq = 0;
+	MGR_AL(alGetBufferi(_Buffer, AL_FREQUENCY, &freq));
+	MGR_AL(alSourcei(_Source, AL_SOURCE_RESAMPLER_SOFT, freq == _State.MixFreq ? _State.ResamplerFast : _State.ResamplerDefault));
+}
+
+static void Mgr_SetSound(SEmitter& _E, const SSound* _Sound)
+{
+	if (_E.Source) {
+		MGR_AL(alSourceStop(_E.Source));
+		MGR_AL(alSourcei(_E.Source, AL_BUFFER, 0));
+	}
+	_E.playing = false;
+	_E.offset = -1;
+	_E.cursor = 0;
+	_E.measured = 0;
+	if (_Sound)
+		Bank_Acquire(*_Sound);
+	if (_E.sound)
+		Bank_Release(*_E.sound);
+	_E.sound = _Sound;
+	_E.bound = 0;
+}
+
+static Uint32 Mgr_BufferFrames(ALuint _Buffer)
+{
+	ALint size = 0, bits = 16, channels = 1;
+	MGR_AL(alGetBufferi(_Buffer, AL_SIZE, &size));
+	MGR_AL(alGetBufferi(_Buffer, AL_BITS, &bits));
+	MGR_AL(alGetBufferi(_Buffer, AL_CHANNELS, &channels));
+	return bits > 0 && channels > 0 ? (Uint32)((Uint64)size * 8 / (bits * channels)) : 0;
+}
+
+// _Gain through the default distance model (inverse clamped, reference 1, rolloff 1).
+static float Mgr_Gain(float _Gain, bool _Direct, const float _Pos[3], const float _Listener[3])
+{
+	float gain = _Gain;
+	if (!_Direct) {
+		float d[3] = { _Pos[0]-_Listener[0], _Pos[1]-_Listener[1], _Pos[2]-_Listener[2] };
+		float dist = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+		if (dist > 1.f)
+			gain /= dist;
+	}
+	return gain;
+}
+
+// weighted down when the sound ends within the horizon.
+static float Mgr_Audibility(const SMgrPlay& _Play, const float _Listener[3], float _Remaining)
+{
+	float gain = Mgr_Gain(FromDecibel(_Play.dB), _Play.direct, _Play.pos, _Listener);
+	return _Remaining < MGR_STEAL_HORIZON ? gain * _Remaining / MGR_STEAL_HORIZON : gain;
+}
+
+// stopped without a click, recycled once faded out.
+static void Mgr_FadeOut(SMgrState& _State, int _Index)
+{
+	const Uint32 now = SDL_GetTicks();
+	_State.ActiveFades[_Index] = now | 1;
+	Mgr_RampTo(_State.ActiveRamps[_Index], 0.f, MGR_STEAL_FADE_MS, MGR_CURVE_EXP, now);
+}
+
+// fades out the least audible voice of lower or equal priority in the pool of _Play to make room for it,
+// false if they are all more important. a voice already fading for no play is reused.
+static bool Mgr_Steal(SMgrState& _State, const SMgrPlay& _Play)
+{
+	const int pool = Mgr_Pool(_Play.sound->buffer);
+	int cFading = 0;
+	for (int i = 0; i < _State.cActive; i++)
+		cFading += _State.ActiveFades[i] != 0 && _State.ActivePools[i] == pool;
+	for (int i = 0; i < _State.cPending; i++)
+		cFading -= _State.Pending[i].stole && Mgr_Pool(_State.Pending[i].sound->buffer) == pool;
+	if (cFading > 0)
+		return true;
+
+	float listener[3];
+	MGR_AL(alGetListenerfv(AL_POSITION, listener));
+
+	int victim = -1;
+	float weakest = 0;
+	for (int i = 0; i < _State.cActive; i++) {
+		const SMgrPlay& P = _State.ActivePlays[i];
+		if (_State.ActiveFades[i] != 0 || _State.ActivePools[i] != pool || P.priority > _Play.priority)
+			continue;
+		ALint freq = 0, offset = 0;
+		MGR_AL(alGetBufferi(_State.ActiveBuffers[i], AL_FREQUENCY, &freq));
+		MGR_AL(alGetSourcei(_State.Active[i], AL_SAMPLE_OFFSET, &offset));
+		float remaining = freq > 0 ? (float)((Sint64)Mgr_BufferFrames(_State.ActiveBuffers[i]) - offset) / freq : 0;
+		float score = Mgr_Audibility(P, listener, remaining);
+		if (victim < 0 || P.priority < _State.ActivePlays[victim].priority || (P.priority == _State.ActivePlays[victim].priority && score < weakest)) {
+			victim = i;
+			weakest = score;
+		}
+	}
+	if (victim < 0)
+		return false;
+
+	// the new play must be louder than what it replaces at the same priority.
+	if (_State.ActivePlays[victim].priority == _Play.priority) {
+		ALint freq = 0;
+		MGR_AL(alGetBufferi(_Play.sound->buffer, AL_FREQUENCY, &freq));
+		float length = freq > 0 ? (float)Mgr_BufferFrames(_Play.sound->buffer) / freq : 0;
+		if (Mgr_Audibility(_Play, listener, length) <= weakest)
+			return false;
+	}
+
+	Mgr_FadeOut(_State, victim);
+	_State.cStolen++;
+	return true;
+}
+
+// NULL once the one shot of _Handle is over. aliases give the instance of the play they joined.
+static SMgrInstance* Mgr_Instance(SMgrState& _State, HMgrSound _Handle)
+{
+	SMgrInstance* I = &_State.Instances[_Handle & (MGR_MAX_INSTANCES-1)];
+	if (_Handle == 0 || I->handle != _Handle)
+		return NULL;
+	if (I->target != 0) {
+		I = &_State.Instances[I->target & (MGR_MAX_INSTANCES-1)];
+		if (I->handle == 0)
+			return NULL;
+	}
+	return I;
+}
+
+// back to the thread making the handles.
+static void Mgr_FreeSlot(SMgrState& _State, int _Slot)
+{
+	SMgrInstance& I = _State.Instances[_Slot];
+	I.handle = 0;
+	I.target = 0;
+	I.next = 0;
+	const Uint16 slot = _Slot;
+	Ring_Push(_State.Released, &slot);		// (holds every slot)
+}
+
+// the slot of the play of _Handle free again with its aliases, once it is over or dropped.
+static void Mgr_Forget(SMgrState& _State, HMgrSound _Handle)
+{
+	const int slot = _Handle & (MGR_MAX_INSTANCES-1);
+	if (_Handle == 0 || _State.Instances[slot].handle != _Handle)
+		return;
+	int next = _State.Instances[slot].next;
+	Mgr_FreeSlot(_State, slot);
+	while (next != 0) {
+		const int alias = next-1;
+		next = _State.Instances[alias].next;
+		Mgr_FreeSlot(_State, alias);
+	}
+}
+
+// a source of the pool of its sound, for a ready play.
+static bool Mgr_CanStart(SMgrState& _State, const SMgrPlay& _Play)
+{
+	return _State.Pools[Mgr_Pool(_Play.sound->buffer)].cAvail > 0;
+}
+
+// ns, the device clock when it has one.
+static Sint64 Mgr_Clock(const SMgrState& _State)
+{
+	if (_State.alcGetInteger64vSOFT) {
+		ALCint64SOFT clock = 0;
+		_State.alcGetInteger64vSOFT(_State.Device, ALC_DEVICE_CLOCK_SOFT, 1, &clock);
+		return clock;
+	}
+	const Uint64 t = SDL_GetPerformanceCounter(), freq = SDL_GetPerformanceFrequency();
+	return (Sint64)(t / freq * 1000000000 + t % freq * 1000000000 / freq);
+}
+
+// a scheduled play not to start yet: ahead of its time by more than the manager can wait for.
+static bool Mgr_Early(const SMgrState& _State, const SMgrPlay& _Play, Sint64 _Clock)
+{
+	const Sint64 ahead = _State.alSourcePlayAtTimeSOFT ? (Sint64)MGR_SCHEDULE_AHEAD_MS * 1000000 : 0;
+	return _Play.at != 0 && _Play.at - _Clock > ahead;
+}
+
+// the play holds its sound in the bank, the source keeps it until recycled. (Mgr_CanStart)
+// scheduled ones are started by the mixer at their time with AL_SOFT_source_start_delay.
+static void Mgr_Start(SMgrState& _State, const SMgrPlay& _Play)
+{
+	Uint32 delay = 0;		// ms
+	if (_Play.at != 0 && _State.alSourcePlayAtTimeSOFT) {
+		const Sint64 wait = _Play.at - Mgr_Clock(_State);
+		delay = wait > 0 ? (Uint32)(wait / 1000000) : 0;
+	}
+	const int pool = Mgr_Pool(_Play.sound->buffer);
+	SMgrPool& P = _State.Pools[pool];
+	ALuint s = P.Avail[P.cAvail-1];	P.cAvail--;
+	_State.Active[_State.cActive] = s;
+	_State.ActiveOf[Mgr_SourceSlot(_State, s)] = _State.cActive;
+	_State.ActivePools[_State.cActive] = pool;
+	_State.ActivePlays[_State.cActive] = _Play;
+	_State.ActivePlays[_State.cActive].time = SDL_GetTicks() + delay;
+	_State.ActiveBuffers[_State.cActive] = _Play.sound->buffer;
+	_State.ActiveFades[_State.cActive] = 0;
+	SMgrRamp& R = _State.ActiveRamps[_State.cActive];
+	memset(&R, 0, sizeof(R));
+	R.to = FromDecibel(_Play.dB);
+	ALint freq = 0;
+	MGR_AL(alGetBufferi(_Play.sound->buffer, AL_FREQUENCY, &freq));
+	_State.ActiveEnds[_State.cActive] = SDL_GetTicks() + delay + (freq > 0 ? (Uint32)((Uint64)Mgr_BufferFrames(_Play.sound->buffer) * 1000 / freq) : 0);
+	if (SMgrInstance* I = Mgr_Instance(_State, _Play.handle)) {
+		I->index = _State.cActive;
+		I->pending = false;
+	}
+	_State.cActive++;
+
+	MGR_AL(alSourcei(s, AL_BUFFER, _Play.sound->buffer));
+	Mgr_SetResampler(_State, s, _Play.sound->buffer);
+	MGR_AL(alSourcef(s, AL_GAIN, FromDecibel(_Play.dB)));
+	MGR_AL(alSourcei(s, AL_LOOPING, AL_FALSE));
+	MGR_AL(alSourcei(s, AL_DIRECT_CHANNELS_SOFT, _Play.direct?AL_TRUE:AL_FALSE));
+	MGR_AL(alSourcef(s, AL_SOURCE_RADIUS, _Play.radius));
+	MGR_AL(alSource3f(s, AL_POSITION, _Play.pos[0], _Play.pos[1], _Play.pos[2]));
+	MGR_AL(alSource3f(s, AL_VELOCITY, 0, 0, 0));
+
+	if (_Play.at != 0 && _State.alSourcePlayAtTimeSOFT)
+		MGR_AL(_State.alSourcePlayAtTimeSOFT(s, _Play.at));
+	else
+		MGR_AL(alSourcePlay(s));
+}
+
+// ------------------- virtual voices -------------------------
+// frame count, rate and loop of the sound buffer, read again once reloaded.
+static void Mgr_Measure(const SMgrState& _State, SEmitter& _E)
+{
+	const ALuint buffer = _E.sound->buffer;
+	if (_E.measured == buffer)
+		return;
+	ALint freq = 0;
+	MGR_AL(alGetBufferi(buffer, AL_FREQUENCY, &freq));
+	_E.measured = buffer;
+	_E.freq = freq;
+	_E.frames = Mgr_BufferFrames(buffer);
+	_E.loop_start = _E.loop_end = 0;
+	if (_State.LoopPoints) {
+		ALint loop[2] = { 0, 0 };
+		MGR_AL(alGetBufferiv(buffer, AL_LOOP_POINTS_SOFT, loop));
+		if (loop[0] >= 0 && loop[1] > loop[0] && (Uint32)loop[1] <= _E.frames) {
+			_E.loop_start = loop[0];
+			_E.loop_end = loop[1];
+		}
+	}
+	if (_E.cursor >= _E.frames)
+		_E.cursor = 0;
+}
+
+// where the source would be: loops wrap into their loop points,
+// one shots start over as active emitters are played again.
+static void Mgr_Advance(SEmitter& _E, float _dt)
+{
+	if (_E.freq <= 0 || _E.frames == 0)
+		return;
+	_E.cursor += (double)_dt * _E.freq;
+	double start = 0, end = _E.frames;
+	if (_E.loop && _E.loop_end > _E.loop_start) {
+		start = _E.loop_start;
+		end = _E.loop_end;
+	}
+	if (_E.cursor >= end)
+		_E.cursor = start + fmod(_E.cursor - start, end - start);
+}
+
+// the tier of an emitter heard at _Gain, kept from _Lod (-1: none yet) until left by MGR_LOD_HYSTERESIS_DB.
+static int Mgr_Lod(int _Lod, float _Gain)
+{
+	const float bounds[MGR_LOD_COUNT-1] = { FromDecibel(MGR_LOD_PAN_DB), FromDecibel(MGR_LOD_CENTER_DB) };
+	const float h = FromDecibel(MGR_LOD_HYSTERESIS_DB);
+	int quieter = 0, louder = 0, lod = 0;
+	for (int k = 0; k < MGR_LOD_COUNT-1; k++) {
+		lod += _Gain < bounds[k];
+		quieter += _Gain * h < bounds[k];
+		louder += _Gain < bounds[k] * h;
+	}
+	if (_Lod < 0)
+		return lod;
+	if (quieter > _Lod)
+		return quieter;
+	if (louder < _Lod)
+		return louder;
+	return _Lod;
+}
+
+// promoted: played from where it would be, at the next update.
+static void Mgr_Bind(SMgrState& _State, SEmitter& _E)
+{
+	ALuint s = _State.Voices[_State.cVoices-1];	_State.cVoices--;
+	_E.Source = s;
+	_E.bound = _E.sound->buffer;
+	_E.offset = -1;
+	MGR_AL(alSourcei(s, AL_BUFFER, _E.bound));
+	Mgr_SetResampler(_State, s, _E.bound);
+	MGR_AL(alSourcei(s, AL_LOOPING, _E.loop ? AL_TRUE : AL_FALSE));
+	MGR_AL(alSourcei(s, AL_DIRECT_CHANNELS_SOFT, _E.direct ? AL_TRUE : AL_FALSE));
+	MGR_AL(alSourcei(s, AL_SAMPLE_OFFSET, (ALint)_E.cursor));
+	_E.playing = false;
+	_E.dirty = EMITTER_DIRTY_ALL;
+	Mgr_SyncHot(_State, _E);
+}
+
+static void Mgr_Unbind(SMgrState& _State, SEmitter& _E)
+{
+	ALint offset = 0;
+	MGR_AL(alGetSourcei(_E.Source, AL_SAMPLE_OFFSET, &offset));
+	_E.cursor = offset;
+	MGR_AL(alSourceStop(_E.Source));
+	MGR_AL(alSourcei(_E.Source, AL_BUFFER, 0));
+	_State.Voices[_State.cVoices] = _E.Source;	_State.cVoices++;
+	_E.Source = 0;
+	_E.bound = 0;
+	_E.offset = -1;
+	_E.playing = false;
+	_E.stopping = false;
+	Mgr_SyncHot(_State, _E);
+}
+
+// streamed emitters keep a source of the stereo pool.
+static void Mgr_SetStream(SMgrState& _State, SEmitter& _E, SStream* _Stream)
+{
+	SMgrPool& P = _State.Pools[MGR_POOL_STEREO];
+	if (_E.Source && !_E.stream)
+		Mgr_Unbind(_State, _E);
+	if (_E.stream) {
+		Stream_Attach(_E.stream, 0);
+		P.Avail[P.cAvail] = _E.Source;	P.cAvail++;
+		_E.Source = 0;
+	}
+	_E.stream = _Stream;
+	if (_Stream) {
+		if (P.cAvail == 0) {
+			ERR("Mgr_SetStream: No stereo source left\n");
+			_E.stream = NULL;
+		} else {
+			_E.Source = P.Avail[P.cAvail-1];	P.cAvail--;
+			MGR_AL(alSourcei(_E.Source, AL_DIRECT_CHANNELS_SOFT, _E.direct ? AL_TRUE : AL_FALSE));
+			Stream_Attach(_Stream, _E.Source);
+			_E.playing = false;
+			_E.dirty = EMITTER_DIRTY_ALL;
+		}
+	}
+	Mgr_SyncHot(_State, _E);
+}
+
+static void Mgr_Recycle(SMgrState& _State, int _Index)
+{
+	const int last = _State.cActive-1;
+	Bank_Release(*_State.ActivePlays[_Index].sound);
+	Mgr_Forget(_State, _State.ActivePlays[_Index].handle);
+	// (an idle source holding its buffer would keep it from being deleted)
+	MGR_AL(alSourceStop(_State.Active[_Index]));
+	MGR_AL(alSourcei(_State.Active[_Index], AL_BUFFER, 0));
+	SMgrPool& P = _State.Pools[_State.ActivePools[_Index]];
+	P.Avail[P.cAvail] = _State.Active[_Index];	P.cAvail++;
+	_State.ActiveOf[Mgr_SourceSlot(_State, _State.Active[_Index])] = -1;
+	if (_Index != last)
+		_State.ActiveOf[Mgr_SourceSlot(_State, _State.Active[last])] = _Index;
+	_State.Active[_Index] = _State.Active[last];
+	_State.ActivePools[_Index] = _State.ActivePools[last];
+	_State.ActivePlays[_Index] = _State.ActivePlays[last];
+	_State.ActiveBuffers[_Index] = _State.ActiveBuffers[last];
+	_State.ActiveFades[_Index] = _State.ActiveFades[last];
+	_State.ActiveRamps[_Index] = _State.ActiveRamps[last];
+	_State.ActiveEnds[_Index] = _State.ActiveEnds[last];
+	_State.cActive --;
+	if (SMgrInstance* I = Mgr_Instance(_State, _State.ActivePlays[_Index].handle))
+		I->index = _Index;
+}
+
+// started or dropped. (the sound is released by the caller if dropped)
+static void Mgr_RemovePending(SMgrState& _State, int _Index)
+{
+	const int last = _State.cPending-1;
+	SMgrInstance* I = Mgr_Instance(_State, _State.Pending[_Index].handle);
+	if (I && I->pending)
+		Mgr_Forget(_State, _State.Pending[_Index].handle);
+	_State.Pending[_Index] = _State.Pending[last];		_State.cPending --;
+	if ((I = Mgr_Instance(_State, _State.Pending[_Index].handle)) && I->pending)
+		I->index = _Index;
+}
+
+// pushes the emitter fields changed since the last update.
+static void Mgr_SendParams(const SMgrState& _State, SEmitter& _E)
+{
+	const ALuint s = _E.Source;
+	const int i = &_E - _State.Emitters;
+	float pos[3] = { _State.Hot.x[i], _State.Hot.y[i], _State.Hot.z[i] };
+	if (_E.moved != 0) {
+		// where it is by now, the params come once per frame.
+		const float t = SDL_min(SDL_max((Sint32)(_State.Time - _E.moved), 0), MGR_EXTRAPOLATE_MS) * .001f;
+		for (int c = 0; c < 3; c++)
+			pos[c] += _E.vel[c] * t;
+	}
+	const float gain = Mgr_Ramp(_E.ramp, _State.Time);
+	float vel[3] = { 0.f, 0.f, 0.f };
+	if (_E.lod == MGR_LOD_FULL)
+		memcpy(vel, _E.vel, sizeof(vel));
+	int dirty = _State.Dirty ? _E.dirty : EMITTER_DIRTY_ALL;
+	if (gain != _E.sent_gain)
+		dirty |= EMITTER_DIRTY_GAIN;
+	if (_E.radius != _E.sent_radius)
+		dirty |= EMITTER_DIRTY_RADIUS;
+	if (memcmp(pos, _E.sent_pos, sizeof(pos)) != 0)
+		dirty |= EMITTER_DIRTY_POSITION;
+	if (memcmp(vel, _E.sent_vel, sizeof(vel)) != 0)
+		dirty |= EMITTER_DIRTY_VELOCITY;
+
+	if (dirty & EMITTER_DIRTY_GAIN)
+		MGR_AL(alSourcef(s, AL_GAIN, gain));
+	if (dirty & EMITTER_DIRTY_RADIUS)
+		MGR_AL(alSourcef(s, AL_SOURCE_RADIUS, _E.radius));
+	if (dirty & EMITTER_DIRTY_POSITION)
+		MGR_AL(alSource3f(s, AL_POSITION, pos[0], pos[1], pos[2]));
+	if (dirty & EMITTER_DIRTY_VELOCITY)
+		MGR_AL(alSource3f(s, AL_VELOCITY, vel[0], vel[1], vel[2]));
+	if (dirty & EMITTER_DIRTY_LOD) {
+		if (_State.Spatialize)
+			MGR_AL(alSourcei(s, AL_SOURCE_SPATIALIZE_SOFT, _E.lod == MGR_LOD_CENTER ? AL_FALSE : AL_AUTO_SOFT));
+		if (_E.stream == NULL && _E.lod != MGR_LOD_FULL && _State.ResamplerDefault >= 0)
+			MGR_AL(alSourcei(s, AL_SOURCE_RESAMPLER_SOFT, _State.ResamplerFast));
+		else if (_E.stream == NULL)
+			Mgr_SetResampler(_State, s, _E.bound);
+	}
+
+	_E.sent_gain = gain;
+	_E.sent_radius = _E.radius;
+	memcpy(_E.sent_pos, pos, sizeof(pos));
+	memcpy(_E.sent_vel, vel, sizeof(vel));
+	_E.dirty = 0;
+}
+
+static int Mgr_Update(SMgrState& _State)
+{
+	int cActive = 0;
+	_State.cALCalls = s_cALCalls;
+	s_cALCalls = 0;
+
+	const Sint64 clock = Mgr_Clock(_State);
+	for (int i = 0; i < _State.cPending; i++) {
+		SMgrPlay& P = _State.Pending[i];
+		if (Mgr_Early(_State, P, clock)) {
+			P.time = SDL_GetTicks();		// (loading timeout from its time)
+			continue;
+		}
+		int state = Sound_State(*P.sound);
+		if (state == SOUND_QUEUED || state == SOUND_LOADING) {
+			if (SDL_GetTicks() - P.time < MGR_PENDING_TIMEOUT_MS)
+				continue;
+			ERR("Mgr_Update(%s): play dropped, sound still loading\n", P.sound->path);
+			Bank_Release(*P.sound);
+		} else if (state == SOUND_READY && !Mgr_CanStart(_State, P)) {
+			if (P.stole || (P.stole = Mgr_Steal(_State, P)))
+				continue;
+			ERR("Too many sounds\n");
+			_State.cDropped++;
+			Bank_Release(*P.sound);
+		} else if (state == SOUND_READY) {
+			Mgr_Start(_State, P);
+		} else {
+			Bank_Release(*P.sound);
+		}
+		Mgr_RemovePending(_State, i);
+		i--;
+	}
+
+	// finished one shots are reported by the AL event thread, only checked still stopped
+	// since their source may have been reused meanwhile.
+	const bool events = _State.Events.data != NULL;
+	SMgrEvent Ev;
+	while (events && Ring_Pop(_State.Events, &Ev)) {
+		const int slot = Mgr_SourceSlot(_State, Ev.source);
+		const int i = slot >= 0 ? _State.ActiveOf[slot] : -1;
+		if (i < 0)
+			continue;
+		ALenum state = AL_STOPPED;
+		MGR_AL(alGetSourcei(Ev.source, AL_SOURCE_STATE, &state));
+		if (state != AL_PLAYING) {
+			float delay = 1000.f * (SDL_GetPerformanceCounter() - Ev.time) / SDL_GetPerformanceFrequency();
+			_State.RecycleDelay += (delay - _State.RecycleDelay) * .1f;
+			_State.cRecycled++;
+			Mgr_Recycle(_State, i);
+		}
+	}
+
+	// else polled once they should have ended. fading ones are stopped here.
+	const bool poll = !events || SDL_AtomicSet(&_State.EventsLost, 0) != 0;
+	const Uint32 now = SDL_GetTicks();
+	for (int i = 0; i<_State.cActive; i++) {
+		ALuint s = _State.Active[i];
+		ALenum state = AL_PLAYING;
+		if (!_State.Dirty || _State.ActiveFades[i] != 0 || (poll && (Sint32)(now + MGR_END_MARGIN_MS - _State.ActiveEnds[i]) >= 0))
+			MGR_AL(alGetSourcei(s, AL_SOURCE_STATE, &state));
+		if (state == AL_PLAYING && _State.ActiveFades[i] != 0 && _State.ActiveRamps[i].ms == 0) {
+			// stolen: faded out, then recycled.
+			MGR_AL(alSourceStop(s));
+			state = AL_STOPPED;
+		}
+		if (state != AL_PLAYING) {
+			Mgr_Recycle(_State, i);
+			i--;
+		} else {
+			cActive ++;
+		}
+	}
+
+	// virtual voices: the most audible emitters get the sources, the others advance in software.
+	const float dt = _State.Time != 0 ? (now - _State.Time) * .001f : 0.f;
+	_State.Time = now;
+	float listener[3];
+	MGR_AL(alGetListenerfv(AL_POSITION, listener));
+
+	const int cSlots = _State.nVoices;		// (bound or not)
+
+	// the emitters around the listener scored at once, only the few louder than the current top are looked at.
+	SEmitterHot& S = _State.Scored;
+	const Uint64 t0 = SDL_GetPerformanceCounter();
+	const int cNear = Mgr_Query(_State, listener);
+	Audibility_Score(S.x, S.y, S.z, S.gain, S.rolloff, S.bias, S.score, cNear, listener);
+	_State.ScoreUs = 1e6f * (SDL_GetPerformanceCounter() - t0) / SDL_GetPerformanceFrequency();
+
+	int Top[MGR_EMITTER_SOURCES];	float TopGain[MGR_EMITTER_SOURCES];	int cTop = 0;	// loudest first
+	for (int n=0; n < cNear; n++) {
+		const int i = _State.Grid.Near[n];
+		const float gain = S.score[n];
+		if (gain <= 0.f || (cTop == cSlots && (cSlots == 0 || gain <= TopGain[cTop-1])))
+			continue;
+		const SEmitter& E = _State.Emitters[i];
+		if (!E.sound || Sound_State(*E.sound) != SOUND_READY)
+			continue;
+		int k = cTop < cSlots ? cTop++ : cTop-1;
+		for (; k > 0 && TopGain[k-1] < gain; k--) {
+			Top[k] = Top[k-1];
+			TopGain[k] = TopGain[k-1];
+		}
+		Top[k] = i;
+		TopGain[k] = gain;
+	}
+	for (int k = 0; k < cTop; k++)
+		_State.Emitters[Top[k]].audible = true;
+	// (backwards: an unbound emitter leaves Bound, the last one taking its place)
+	for (int b = _State.Bound.cItems-1; b >= 0; b--) {
+		SEmitter& E = _State.Emitters[_State.Bound.Items[b]];
+		if (!E.stream && !E.audible)
+			Mgr_Unbind(_State, E);
+	}
+	for (int k = 0; k < cTop; k++) {
+		SEmitter& E = _State.Emitters[Top[k]];
+		E.audible = false;
+		if (E.Source == 0) {
+			E.lod = Mgr_Lod(-1, TopGain[k]);
+			Mgr_Measure(_State, E);
+			Mgr_Bind(_State, E);
+		} else {
+			// (the score has the hysteresis of bound emitters)
+			const int lod = Mgr_Lod(E.lod, TopGain[k] / MGR_VIRTUAL_HYSTERESIS);
+			if (lod != E.lod) {
+				E.lod = lod;
+				E.dirty |= EMITTER_DIRTY_LOD;
+			}
+		}
+	}
+
+	// parameters applied by the mixer at once, before the sources start.
+	if (_State.alDeferUpdatesSOFT)
+		MGR_AL(_State.alDeferUpdatesSOFT());
+	for (int i = 0; i<_State.cActive; i++) {
+		if (_State.ActiveRamps[i].ms != 0)
+			MGR_AL(alSourcef(_State.Active[i], AL_GAIN, Mgr_Ramp(_State.ActiveRamps[i], now)));
+	}
+	for (int b = 0; b < _State.Bound.cItems; b++)
+		Mgr_SendParams(_State, _State.Emitters[_State.Bound.Items[b]]);
+	if (_State.alDeferUpdatesSOFT)
+		MGR_AL(_State.alProcessUpdatesSOFT());
+
+	_State.cVirtual = 0;
+	for (int v = 0; v < _State.Virtual.cItems; v++) {
+		SEmitter& E = _State.Emitters[_State.Virtual.Items[v]];
+		if (E.sound && Sound_State(*E.sound) == SOUND_READY) {
+			Mgr_Measure(_State, E);
+			Mgr_Advance(E, dt);
+			_State.cVirtual++;
+		}
+	}
+	for (int b = 0; b < _State.Bound.cItems; b++) {
+		SEmitter& E = _State.Emitters[_State.Bound.Items[b]];
+		ALuint s = E.Source;
 
-#define ERR(...)    fprintf(stderr, __VA_ARGS__)
-static const float PI = 3.14159f;
+		if (E.stopping && E.ramp.ms == 0) {
+			E.stopping = false;
+			Mgr_SyncHot(_State, E);
+		}
+		ALenum state = E.playing ? AL_PLAYING : AL_STOPPED;
+		bool polled = false;
+		if (E.sound && E.bound != 0 && E.bound != E.sound->buffer) {
+			// reloaded: a looping source switches where it wraps, at the same offset.
+			ALint looping = AL_FALSE, offset = 0;
+			MGR_AL(alGetSourcei(s, AL_SOURCE_STATE, &state));
+			polled = true;
+			MGR_AL(alGetSourcei(s, AL_LOOPING, &looping));
+			MGR_AL(alGetSourcei(s, AL_SAMPLE_OFFSET, &offset));
+			if (state != AL_PLAYING || (looping && E.offset >= 0 && offset < E.offset)) {
+				MGR_AL(alSourceStop(s));
+				MGR_AL(alSourcei(s, AL_BUFFER, E.sound->buffer));
+				Mgr_SetResampler(_State, s, E.sound->buffer);
+				E.bound = E.sound->buffer;
+				E.dirty |= EMITTER_DIRTY_LOD;
+				if (state == AL_PLAYING) {
+					if ((Uint32)offset < Mgr_BufferFrames(E.bound))
+						MGR_AL(alSourcei(s, AL_SAMPLE_OFFSET, offset));
+					MGR_AL(alSourcePlay(s));
+				}
+				offset = -1;
+			}
+			E.offset = offset;
+		}
+		bool ready = E.stream != NULL || E.bound != 0;
 
-static float FromDecibel(float dB)
-{
-	float Gain = exp10f(dB / 20.f);
-	return Gain < 0.0001f ? 0 : Gain;
+		// looping sources don't stop by themselves, streams may starve.
+		if (!polled && (!_State.Dirty || (E.playing && (!E.loop || E.stream))))
+			MGR_AL(alGetSourcei(s, AL_SOURCE_STATE, &state));
+		if (state == AL_PLAYING)
+			cActive ++;
+		if (E.active && ready && state != AL_PLAYING) {
+			MGR_AL(alSourcePlay(s));
+			state = AL_PLAYING;
+		} else if (!E.active && !E.stopping && state != AL_STOPPED) {
+			MGR_AL(alSourceStop(s));
+			state = AL_STOPPED;
+		}
+		E.playing = state == AL_PLAYING;
+	}
+
+	// buffers replaced by reloads go once no source plays them.
+	ALuint* InUse = _State.InUse;
+	int cInUse = _State.cActive;
+	memcpy(InUse, _State.ActiveBuffers, _State.cActive*sizeof(ALuint));
+	for (int b = 0; b < _State.Bound.cItems; b++) {
+		const SEmitter& E = _State.Emitters[_State.Bound.Items[b]];
+		if (E.bound != 0)
+			InUse[cInUse++] = E.bound;
+	}
+	Loader_Collect(InUse, cInUse);
+
+	return cActive;
 }
 
-static float ToDecibel(float gain)
+// ------------------- sound groups -------------------------
+static void Mgr_SetGroup(SMgrState& _State, int _Group, int _Max, Uint32 _Window)
 {
-	if (gain <= .001f) // -60dB
-		return -60.f;
-	else
-		return 20.f * log10f(gain);
+	if (_Group <= 0 || _Group >= MGR_MAX_GROUPS)
+		return;
+	_State.Groups[_Group].max = _Max;
+	_State.Groups[_Group].window = _Window;
 }
 
-// -------------------  LoadSound -------------------------
-static ALuint LoadSound(const char* name)
+// a play of the same sound in the group, started or queued within the window, takes the gain
+// of _Play too (summed in power, the copies are not in phase). _Play.handle then names that play.
+static bool Mgr_Coalesce(SMgrState& _State, const SMgrPlay& _Play)
 {
-	SDL_AudioSpec wav_spec;
-	Uint32 wav_length;
-	Uint8 *wav_buffer;
-	if (SDL_LoadWAV(name, &wav_spec, &wav_buffer, &wav_length) == NULL) {
-		ERR("LoadSound(%s): SDL_LoadWAV failed: %s\n", name, SDL_GetError());
-		return 0;
+	SMgrGroup& G = _State.Groups[_Play.group];
+	if (G.window == 0)
+		return false;
+	const Uint32 now = SDL_GetTicks();
+	SMgrPlay* P = NULL;
+	int active = -1, pending = -1;
+	for (int i = 0; i < _State.cPending && P == NULL; i++) {
+		SMgrPlay& Q = _State.Pending[i];
+		if (Q.group == _Play.group && Q.sound == _Play.sound && Q.at == _Play.at && now - Q.time <= G.window) {
+			P = &Q;
+			pending = i;
+		}
+	}
+	for (int i = 0; i < _State.cActive && P == NULL; i++) {
+		SMgrPlay& Q = _State.ActivePlays[i];
+		if (_State.ActiveFades[i] == 0 && Q.group == _Play.group && Q.sound == _Play.sound && Q.at == _Play.at && now - Q.time <= G.window) {
+			P = &Q;
+			active = i;
+		}
+	}
+	if (P == NULL)
+		return false;
+
+	const float a = FromDecibel(P->dB), b = FromDecibel(_Play.dB);
+	P->dB = ToDecibel(sqrtf(a*a + b*b));
+	if (active >= 0)
+		Mgr_RampTo(_State.ActiveRamps[active], FromDecibel(P->dB), MGR_START_FADE_MS, MGR_CURVE_LINEAR, now);
+	G.cCoalesced++;
+
+	// (the slot of _Play.handle was free when it was given)
+	if (_Play.handle != 0) {
+		const int slot = _Play.handle & (MGR_MAX_INSTANCES-1);
+		SMgrInstance& I = _State.Instances[slot];
+		memset(&I, 0, sizeof(I));
+		I.handle = _Play.handle;
+		if (P->handle == 0) {
+			// the play joined had no handle, it takes this one.
+			P->handle = _Play.handle;
+			I.index = pending >= 0 ? pending : active;
+			I.pending = pending >= 0;
+		} else {
+			SMgrInstance& J = _State.Instances[P->handle & (MGR_MAX_INSTANCES-1)];
+			I.target = P->handle;
+			I.next = J.next;
+			J.next = slot+1;
+		}
 	}
+	return true;
+}
 
-	ALenum format = 0;
-	if (wav_spec.channels == 1) {
-		switch(wav_spec.format) {
-		case AUDIO_U8:			format = AL_FORMAT_MONO8; break;
-		case AUDIO_S16LSB:		format = AL_FORMAT_MONO16; break;
-		case AUDIO_F32LSB:		format = AL_FORMAT_MONO_FLOAT32; break;
+// a group at its limit makes room: its oldest instance fades out, or is dropped while pending.
+static void Mgr_Limit(SMgrState& _State, int _Group)
+{
+	SMgrGroup& G = _State.Groups[_Group];
+	if (G.max <= 0)
+		return;
+	const Uint32 now = SDL_GetTicks();
+	int count = 0, oldest = -1;
+	bool pending = false;
+	Uint32 age = 0;
+	for (int i = 0; i < _State.cPending; i++) {
+		const SMgrPlay& P = _State.Pending[i];
+		if (P.group != _Group || P.at != 0)
+			continue;
+		count++;
+		if (oldest < 0 || now - P.time > age) {
+			oldest = i;
+			pending = true;
+			age = now - P.time;
 		}
-	} else if (wav_spec.channels == 2) {
-		switch(wav_spec.format) {
-		case AUDIO_U8:			format = AL_FORMAT_STEREO8; break;
-		case AUDIO_S16LSB:		format = AL_FORMAT_STEREO16; break;
-		case AUDIO_F32LSB:		format = AL_FORMAT_STEREO_FLOAT32; break;
+	}
+	for (int i = 0; i < _State.cActive; i++) {
+		const SMgrPlay& P = _State.ActivePlays[i];
+		if (P.group != _Group || _State.ActiveFades[i] != 0)
+			continue;
+		count++;
+		if (oldest < 0 || now - P.time > age) {
+			oldest = i;
+			pending = false;
+			age = now - P.time;
 		}
 	}
+	if (count < G.max)
+		return;
 
-	if (format == 0) {
-		// TODO: if needed, more channels / other formats.
-		ERR("LoadSound(%s): Unsupported format (TODO): 0x%X\n", name, wav_spec.format);
-		SDL_FreeWAV(wav_buffer);
-		return 0;
+	G.cLimited++;
+	if (pending) {
+		Bank_Release(*_State.Pending[oldest].sound);
+		Mgr_RemovePending(_State, oldest);
+	} else {
+		Mgr_FadeOut(_State, oldest);
 	}
+}
 
-	ALuint buffer;
-	alGenBuffers(1, &buffer);
-	alBufferData(buffer, format, wav_buffer, wav_length, wav_spec.freq);
-	SDL_FreeWAV(wav_buffer);
+// plays of a sound still loading are deferred until it is ready, or dropped if it failed.
+// bank sounds evicted meanwhile are loaded again.
+// with every source busy, a weaker voice is stolen and the play starts once it faded out.
+// _Play.handle then names the one shot, 0 when dropped (its slot is given back).
+// in a group, a play coalesced keeps its handle as an alias of the one it joined,
+// and one over the limit stops the oldest. (scheduled plays join only those at the same time
+// and are not counted in the limit while they wait)
+// plays scheduled ahead wait in Pending, sequences can be submitted at once.
+static HMgrSound Mgr_Play(SMgrState& _State, const SMgrPlay& _Play)
+{
+	if (_Play.group > 0 && _Play.group < MGR_MAX_GROUPS) {
+		if (Mgr_Coalesce(_State, _Play))
+			return _Play.handle;
+		Mgr_Limit(_State, _Play.group);
+	}
+	const bool early = Mgr_Early(_State, _Play, Mgr_Clock(_State));
+
+	// (the slot of _Play.handle was free when it was given)
+	if (_Play.handle != 0) {
+		SMgrInstance& I = _State.Instances[_Play.handle & (MGR_MAX_INSTANCES-1)];
+		memset(&I, 0, sizeof(I));
+		I.handle = _Play.handle;
+		I.index = _State.cPending;
+		I.pending = true;
+	}
 
-	ALenum err = alGetError();
-	if(err != AL_NO_ERROR)
-	{
-		ERR("LoadSound(%s): alBufferData Error: %s\n", name, alGetString(err));
-		if(alIsBuffer(buffer))
-			alDeleteBuffers(1, &buffer);
+	Bank_Acquire(*_Play.sound);
+	int state = Sound_State(*_Play.sound);
+	if (!early && state == SOUND_READY && Mgr_CanStart(_State, _Play)) {
+		Mgr_Start(_State, _Play);
+		return _Play.handle;
+	}
+	if (state != SOUND_READY && state != SOUND_QUEUED && state != SOUND_LOADING) {
+		Bank_Release(*_Play.sound);
+		Mgr_Forget(_State, _Play.handle);
 		return 0;
 	}
 
-	return buffer;
+	if (_State.cPending == MGR_MAX_PENDING) {
+		ERR("Too many pending sounds\n");
+		_State.cDropped++;
+		Bank_Release(*_Play.sound);
+		Mgr_Forget(_State, _Play.handle);
+		return 0;
+	}
+	SMgrPlay& P = _State.Pending[_State.cPending];
+	P = _Play;
+	P.time = SDL_GetTicks();
+	P.stole = false;
+	if (!early && state == SOUND_READY && !(P.stole = Mgr_Steal(_State, P))) {
+		ERR("Too many sounds\n");
+		_State.cDropped++;
+		Bank_Release(*_Play.sound);
+		Mgr_Forget(_State, _Play.handle);
+		return 0;
+	}
+	_State.cPending++;
+	return _Play.handle;
 }
 
-static void FreeSound(ALuint _Buf)
+// ------------------- sound handles -------------------------
+// stale handles do nothing.
+
+// faded out like a stolen voice, a pending play is dropped.
+static void Mgr_StopSound(SMgrState& _State, HMgrSound _Handle)
 {
-	if(alIsBuffer(_Buf))
-		alDeleteBuffers(1, &_Buf);
+	SMgrInstance* I = Mgr_Instance(_State, _Handle);
+	if (I == NULL)
+		return;
+	if (I->pending) {
+		Bank_Release(*_State.Pending[I->index].sound);
+		Mgr_RemovePending(_State, I->index);
+	} else if (_State.ActiveFades[I->index] == 0) {
+		Mgr_FadeOut(_State, I->index);
+	}
 }
 
-
-
-// ------------------- Program resources -------------------------
-
-struct SResources
+// reached in _Ms along _Curve, from the current gain.
+static void Mgr_SetSoundGain(SMgrState& _State, HMgrSound _Handle, float _dB, Uint32 _Ms=0, int _Curve=MGR_CURVE_LINEAR)
 {
-	ALuint	albuf_mono;
-	ALuint	albuf_stereo;
-	ALuint  albuf_monoloop;
-	ALuint  albuf_stereoloop;
-};
+	SMgrInstance* I = Mgr_Instance(_State, _Handle);
+	if (I == NULL)
+		return;
+	if (I->pending) {
+		_State.Pending[I->index].dB = _dB;
+		return;
+	}
+	_State.ActivePlays[I->index].dB = _dB;
+	if (_State.ActiveFades[I->index] != 0)
+		return;
+	SMgrRamp& R = _State.ActiveRamps[I->index];
+	Mgr_RampTo(R, FromDecibel(_dB), _Ms, _Curve, SDL_GetTicks());
+	if (_Ms == 0)
+		MGR_AL(alSourcef(_State.Active[I->index], AL_GAIN, R.to));
+}
 
-static bool LoadResources(SResources& _Res)
+static void Mgr_SetSoundPosition(SMgrState& _State, HMgrSound _Handle, const float _Pos[3])
 {
-	_Res.albuf_mono = LoadSound(DResourcesRoot "sonar.wav");
-	if (_Res.albuf_mono == 0)
-		return false;
-
-	_Res.albuf_stereo = LoadSound(DResourcesRoot "bark.wav");
-	if (_Res.albuf_stereo == 0)
-		return false;
-
-	_Res.albuf_monoloop = LoadSound(DResourcesRoot "mosquitoloop.wav");
-	if (_Res.albuf_monoloop == 0)
-		return false;
-
-	_Res.albuf_stereoloop = LoadSound(DResourcesRoot "rainloop.wav");
-	if (_Res.albuf_stereoloop == 0)
-		return false;
+	SMgrInstance* I = Mgr_Instance(_State, _Handle);
+	if (I == NULL)
+		return;
+	SMgrPlay& P = I->pending ? _State.Pending[I->index] : _State.ActivePlays[I->index];
+	memcpy(P.pos, _Pos, sizeof(P.pos));
+	if (!I->pending)
+		MGR_AL(alSource3f(_State.Active[I->index], AL_POSITION, _Pos[0], _Pos[1], _Pos[2]));
+}
 
-	return true;
+// started from silence, stopped once faded out.
+static void Mgr_SetActive(SMgrState& _State, SEmitter& _E, bool _Active)
+{
+	const Uint32 now = SDL_GetTicks();
+	if (_Active && !_E.active) {
+		memset(&_E.ramp, 0, sizeof(_E.ramp));
+		Mgr_RampTo(_E.ramp, Mgr_EmitterGain(_E), MGR_START_FADE_MS, MGR_CURVE_LINEAR, now);
+		_E.stopping = false;
+	} else if (!_Active && _E.active) {
+		Mgr_RampTo(_E.ramp, 0.f, MGR_STEAL_FADE_MS, MGR_CURVE_EXP, now);
+		_E.stopping = _E.Source != 0 && _E.playing;
+	}
+	_E.active = _Active;
+	Mgr_SyncHot(_State, _E);
 }
 
-static void FreeResources(SResources& _Res)
+// the gain goes to the new dB along the ramp of _Params.
+static void Mgr_SetParams(SMgrState& _State, SEmitter& _E, const SEmitterParams& _Params)
 {
-	FreeSound(_Res.albuf_mono);			_Res.albuf_mono = 0;
-	FreeSound(_Res.albuf_stereo);		_Res.albuf_stereo = 0;
-	FreeSound(_Res.albuf_monoloop);		_Res.albuf_monoloop = 0;
-	FreeSound(_Res.albuf_stereoloop);	_Res.albuf_stereoloop = 0;
+	const int i = &_E - _State.Emitters;
+	if (_Params.dB != _E.dB && _E.active) {
+		_E.dB = _Params.dB;
+		Mgr_RampTo(_E.ramp, Mgr_EmitterGain(_E), _Params.ramp, _Params.curve, SDL_GetTicks());
+	}
+	_E.dB = _Params.dB;
+	_E.radius = _Params.radius;
+	_State.Hot.x[i] = _Params.pos[0];
+	_State.Hot.y[i] = _Params.pos[1];
+	_State.Hot.z[i] = _Params.pos[2];
+	memcpy(_E.vel, _Params.vel, sizeof(_E.vel));
+	_E.moved = _Params.time;
+	Mgr_SetActive(_State, _E, _Params.active);
 }
 
 
-// ------------------- OpenAl sources manager -------------------------
-#define MGR_MAX_SOURCES 32
-#define MGR_MAX_EMITTERS 8
-struct SEmitter {
-	ALuint Source;
-	bool  active;
-	float dB;
+// ------------------- audio thread -------------------------
+// the manager, the bank and the sound swaps run there at a fixed rate. the UI only pushes
+// commands and reads the latest snapshot, both without blocking.
+#define AUDIO_MAX_COMMANDS 1024
+#define AUDIO_SNAPSHOT_NEW 4		// (with the index of the snapshot)
+#define AUDIO_MAX_SOUNDS 256		// one shots listed in a snapshot
+
+enum EAudioCommand {
+	AUDIO_CMD_PLAY,
+	AUDIO_CMD_EMITTER,		// SEmitterParams of an emitter
+	AUDIO_CMD_ACTIVE,		// a range of emitters started or stopped
+	AUDIO_CMD_DIRTY,
+	AUDIO_CMD_BUDGET,
+	AUDIO_CMD_RELOAD,		// a data file changed
+	AUDIO_CMD_STOP_SOUND,	// a one shot by handle
+	AUDIO_CMD_SOUND_GAIN,
+	AUDIO_CMD_SOUND_POSITION,
+	AUDIO_CMD_GROUP,		// limits of a sound group
+};
 
-	// spatial
-	float radius;
-	float pos[3];
-	float vel[3];
+struct SAudioCommand {
+	int		type;	// EAudioCommand
+	union {
+		SMgrPlay play;
+		struct { int index; SEmitterParams params; } emitter;
+		struct { int first; int count; bool active; } range;
+		bool	dirty;
+		Uint64	budget;
+		char	name[64];
+		struct { HMgrSound handle; float dB; Uint32 ramp; int curve; float pos[3]; } sound;
+		struct { int index; int max; Uint32 window; } group;
+	};
 };
 
-struct SMgrState {
-	ALuint		Avail[MGR_MAX_SOURCES];		int cAvail;
-	ALuint		Active[MGR_MAX_SOURCES];	int cActive;
+// a one shot playing or pending, offset estimated from its start.
+struct SAudioSound {
+	HMgrSound	handle;
+	float		offset;		// seconds
+};
+
+// what the UI shows.
+struct SAudioSnapshot {
+	Uint32		cExecuted;		// commands
+	int			cPlaying;		// sources
+	int			cSources;		// generated
+	int			cMono;			// one shot pools
+	int			cStereo;
+	int			cOneShots;
+	int			cPending;
+	int			cStolen;
+	int			cDropped;
+	int			cCoalesced;		// all groups
+	int			cLimited;
+	int			cEmitters;
+	int			cVirtual;
+	int			cBound;			// emitters with a source
+	int			cLod[MGR_LOD_COUNT];	// of the bound ones, streams aside
+	int			cALCalls;
+	bool		Deferred;
+	bool		Dirty;
+	bool		Events;
+	int			cRecycled;
+	float		RecycleDelay;
+	int			MixFreq;
+	bool		FastResampler;
+	bool		DeviceClock;	// else the SDL counter
+	bool		StartDelay;		// scheduled plays started by the mixer
+	Sint64		Clock;			// Mgr_Clock at the publish
+	Uint64		ClockCounter;	// SDL_GetPerformanceCounter then
+	float		UpdateMs;		// Mgr_Update and the bank, last tick
+	float		ScoreUs;		// the audibility pass of Mgr_Update
+	int			cScored;		// emitters near the listener
+	float		TickHz;			// measured
+	int			reloads;
+	SBankStats	bank;
+	SBankInfo	bank_sounds[BANK_MAX_SOUNDS];
+	SAudioSound	sounds[AUDIO_MAX_SOUNDS];	int cSounds;
+};
 
-	SEmitter	Emitters[MGR_MAX_EMITTERS];
+struct SAudio {
+	SMgrState*		Mgr;
+	SResources*		Res;
+	int				Hz;
+	SDL_Thread*		Thread;
+	SDL_atomic_t	Quit;
+
+	SRing			Commands;		// SAudioCommand, UI -> audio thread
+	Uint32			cPushed;		// UI side
+	Uint16			FreeSlots[MGR_MAX_INSTANCES];	int cFreeSlots;		// UI side, handle slots
+	Uint32			Generations[MGR_MAX_INSTANCES];		// UI side, of the last handle of each slot
+	Uint32			cExecuted;		// audio side
+
+	// triple buffer: the audio thread writes one, the UI reads another, Ready holds the latest.
+	SAudioSnapshot	Snapshots[3];
+	SDL_atomic_t	Ready;			// index | AUDIO_SNAPSHOT_NEW once written
+	int				Write;
+	int				Read;
 };
 
-static void Mgr_Init(SMgrState& _State)
+static void Audio_Execute(SAudio& _A, const SAudioCommand& _C)
 {
-	memset(&_State, 0, sizeof(_State));
-	alGenSources(MGR_MAX_SOURCES, _State.Avail);
-	_State.cAvail = MGR_MAX_SOURCES;
+	SMgrState& M = *_A.Mgr;
+	switch (_C.type) {
+	case AUDIO_CMD_PLAY:
+		Mgr_Play(M, _C.play);
+		break;
+	case AUDIO_CMD_EMITTER:
+		if (_C.emitter.index >= 0 && _C.emitter.index < M.cEmitters)
+			Mgr_SetParams(M, M.Emitters[_C.emitter.index], _C.emitter.params);
+		break;
+	case AUDIO_CMD_ACTIVE:
+		for (int i = _C.range.first; i < _C.range.first + _C.range.count && i < M.cEmitters; i++)
+			Mgr_SetActive(M, M.Emitters[i], _C.range.active);
+		break;
+	case AUDIO_CMD_DIRTY:
+		M.Dirty = _C.dirty;
+		break;
+	case AUDIO_CMD_BUDGET:
+		Bank_SetBudget(_C.budget);
+		break;
+	case AUDIO_CMD_RELOAD:
+		ReloadResources(*_A.Res, _C.name);
+		break;
+	case AUDIO_CMD_STOP_SOUND:
+		Mgr_StopSound(M, _C.sound.handle);
+		break;
+	case AUDIO_CMD_SOUND_GAIN:
+		Mgr_SetSoundGain(M, _C.sound.handle, _C.sound.dB, _C.sound.ramp, _C.sound.curve);
+		break;
+	case AUDIO_CMD_SOUND_POSITION:
+		Mgr_SetSoundPosition(M, _C.sound.handle, _C.sound.pos);
+		break;
+	case AUDIO_CMD_GROUP:
+		Mgr_SetGroup(M, _C.group.index, _C.group.max, _C.group.window);
+		break;
+	}
+	_A.cExecuted++;
+}
 
-	for (int i=0; i < MGR_MAX_EMITTERS; i++) {
-		ALuint s = _State.Avail[_State.cAvail-1];	_State.cAvail--;
-		_State.Emitters[i].Source = s;
+// a play under its handle and its aliases.
+static void Audio_PublishSound(SAudioSnapshot& _S, const SMgrState& _M, HMgrSound _Handle, float _Offset)
+{
+	int next = _Handle != 0 ? _M.Instances[_Handle & (MGR_MAX_INSTANCES-1)].next : 0;
+	for (;;) {
+		if (_S.cSounds == AUDIO_MAX_SOUNDS)
+			return;
+		SAudioSound& sound = _S.sounds[_S.cSounds++];
+		sound.handle = _Handle;
+		sound.offset = _Offset;
+		if (next == 0)
+			return;
+		_Handle = _M.Instances[next-1].handle;
+		next = _M.Instances[next-1].next;
 	}
 }
 
-static void Mgr_Destroy(SMgrState& _State)
+static void Audio_Publish(SAudio& _A, int _cPlaying, float _UpdateMs, float _TickHz)
 {
-	if (_State.cActive > 0) {
-		alSourceStopv(_State.cActive, _State.Active);
-		memcpy(_State.Avail + _State.cAvail, _State.Active, _State.cActive*sizeof(ALuint));
-		_State.cAvail += _State.cActive;
-		_State.cActive = 0;
+	const SMgrState& M = *_A.Mgr;
+	SAudioSnapshot& S = _A.Snapshots[_A.Write];
+	S.cExecuted = _A.cExecuted;
+	S.cPlaying = _cPlaying;
+	S.cMono = M.Pools[MGR_POOL_MONO].cSources;
+	S.cStereo = M.Pools[MGR_POOL_STEREO].cSources;
+	S.cSources = S.cMono + S.cStereo + M.nVoices;
+	S.cOneShots = M.cActive;
+	S.cPending = M.cPending;
+	S.cStolen = M.cStolen;
+	S.cDropped = M.cDropped;
+	S.cCoalesced = S.cLimited = 0;
+	for (int i = 0; i < MGR_MAX_GROUPS; i++) {
+		S.cCoalesced += M.Groups[i].cCoalesced;
+		S.cLimited += M.Groups[i].cLimited;
 	}
-	for (int i=0; i < MGR_MAX_EMITTERS; i++) {
-		ALuint s = _State.Emitters[i].Source;
-		alSourceStop(s);
-		_State.Emitters[i].Source = 0;
-		_State.Avail[_State.cAvail] = s; _State.cAvail ++;
+	S.cEmitters = M.cEmitters;
+	S.cVirtual = M.cVirtual;
+	S.cBound = M.Bound.cItems;
+	memset(S.cLod, 0, sizeof(S.cLod));
+	for (int b = 0; b < M.Bound.cItems; b++) {
+		const SEmitter& E = M.Emitters[M.Bound.Items[b]];
+		if (!E.stream)
+			S.cLod[E.lod]++;
 	}
-	alDeleteSources(_State.cAvail, _State.Avail);
+	S.cALCalls = M.cALCalls;
+	S.Deferred = M.alDeferUpdatesSOFT != NULL;
+	S.Dirty = M.Dirty;
+	S.Events = M.Events.data != NULL;
+	S.cRecycled = M.cRecycled;
+	S.RecycleDelay = M.RecycleDelay;
+	S.MixFreq = M.MixFreq;
+	S.FastResampler = M.ResamplerFast != M.ResamplerDefault;
+	S.DeviceClock = M.alcGetInteger64vSOFT != NULL;
+	S.StartDelay = M.alSourcePlayAtTimeSOFT != NULL;
+	S.Clock = Mgr_Clock(M);
+	S.ClockCounter = SDL_GetPerformanceCounter();
+	S.UpdateMs = _UpdateMs;
+	S.ScoreUs = M.ScoreUs;
+	S.cScored = M.Grid.cNear;
+	S.TickHz = _TickHz;
+	S.reloads = _A.Res->reloads;
+	S.bank = Bank_Stats();
+	for (int i = 0; i < S.bank.cSounds; i++)
+		Bank_Info(i, S.bank_sounds[i]);
+	const Uint32 now = SDL_GetTicks();
+	S.cSounds = 0;
+	for (int i = 0; i < M.cPending; i++)
+		Audio_PublishSound(S, M, M.Pending[i].handle, 0);
+	for (int i = 0; i < M.cActive; i++)
+		Audio_PublishSound(S, M, M.ActivePlays[i].handle, (now - M.ActivePlays[i].time) * .001f);
+
+	SDL_MemoryBarrierRelease();
+	_A.Write = SDL_AtomicSet(&_A.Ready, _A.Write | AUDIO_SNAPSHOT_NEW) & ~AUDIO_SNAPSHOT_NEW;
 }
 
-static int Mgr_Update(SMgrState& _State)
+static int Audio_Thread(void* _Data)
 {
-	int cActive = 0;
+	SAudio& A = *(SAudio*)_Data;
+	const Uint64 freq = SDL_GetPerformanceFrequency();
+	const Uint64 period = freq / A.Hz;
+	Uint64 next = SDL_GetPerformanceCounter();
+	Uint64 prev = next;
+	float tick_hz = (float)A.Hz;
+
+	while (SDL_AtomicGet(&A.Quit) == 0) {
+		const Uint64 t0 = SDL_GetPerformanceCounter();
+		if (t0 > prev)
+			tick_hz += ((float)freq / (t0 - prev) - tick_hz) * .05f;
+		prev = t0;
+
+		SAudioCommand C;
+		while (Ring_Pop(A.Commands, &C))
+			Audio_Execute(A, C);
+		SwapResources(*A.Res);
+		Bank_Update();
+		int cPlaying = Mgr_Update(*A.Mgr);
+		float ms = 1000.f * (SDL_GetPerformanceCounter() - t0) / freq;
+		Audio_Publish(A, cPlaying, ms, tick_hz);
+
+		// late ticks are not caught up.
+		next += period;
+		const Uint64 now = SDL_GetPerformanceCounter();
+		if (now < next)
+			SDL_Delay((Uint32)((next - now) * 1000 / freq));
+		else
+			next = now;
+	}
+	return 0;
+}
 
-	for (int i = 0; i<_State.cActive; i++) {
-		ALuint s = _State.Active[i];
-		ALenum state = AL_STOPPED;
-		alGetSourcei(s, AL_SOURCE_STATE, &state);
-		if (state != AL_PLAYING) {
-			_State.Avail[_State.cAvail] = s;						_State.cAvail++;
-			_State.Active[i] = _State.Active[_State.cActive-1];		_State.cActive --;
-			i--;
-		} else {
-			cActive ++;
-		}
+// the manager is set up and its emitters created before.
+static bool Audio_Start(SAudio& _A, SMgrState& _Mgr, SResources& _Res, int _Hz)
+{
+	memset(&_A, 0, sizeof(_A));
+	_A.Mgr = &_Mgr;
+	_A.Res = &_Res;
+	_A.Hz = _Hz;
+	_A.Write = 0;
+	_A.Read = 1;
+	SDL_AtomicSet(&_A.Ready, 2);
+	if (!Ring_Init(_A.Commands, sizeof(SAudioCommand), AUDIO_MAX_COMMANDS))
+		return false;
+	for (int i = 0; i < MGR_MAX_INSTANCES; i++)
+		_A.FreeSlots[i] = MGR_MAX_INSTANCES-1 - i;
+	_A.cFreeSlots = MGR_MAX_INSTANCES;
+	_A.Thread = SDL_CreateThread(Audio_Thread, "audio", &_A);
+	if (_A.Thread == NULL) {
+		ERR("Audio_Start: SDL_CreateThread failed: %s\n", SDL_GetError());
+		Ring_Free(_A.Commands);
+		return false;
 	}
+	return true;
+}
 
-	for (int i=0; i < MGR_MAX_EMITTERS; i++) {
-		const SEmitter& E = _State.Emitters[i];
-		ALuint s = E.Source;
-		alSourcef(s, AL_GAIN, FromDecibel(E.dB));
-		alSourcef(s, AL_SOURCE_RADIUS, E.radius);
-		alSource3f(s, AL_POSITION, E.pos[0], E.pos[1], E.pos[2]);
-		alSource3f(s, AL_VELOCITY, E.vel[0], E.vel[1], E.vel[2]);
+static void Audio_Stop(SAudio& _A)
+{
+	if (_A.Thread == NULL)
+		return;
+	SDL_AtomicSet(&_A.Quit, 1);
+	SDL_WaitThread(_A.Thread, NULL);	_A.Thread = NULL;
+	Ring_Free(_A.Commands);
+}
 
-		ALenum state = AL_STOPPED;
-		alGetSourcei(s, AL_SOURCE_STATE, &state);
-		if (state == AL_PLAYING)
-			cActive ++;
-		if (E.active && state != AL_PLAYING)
-			alSourcePlay(s);
-		else if (!E.active && state != AL_STOPPED)
-			alSourceStop(s);
+// ui thread
+static bool Audio_Push(SAudio& _A, const SAudioCommand& _C)
+{
+	if (!Ring_Push(_A.Commands, &_C)) {
+		ERR("Audio_Push: Too many commands\n");
+		return false;
 	}
+	_A.cPushed++;
+	return true;
+}
 
-	return cActive;
+// taken once per frame, then passed down: taken again, it could be newer than the one already shown.
+static const SAudioSnapshot& Audio_Snapshot(SAudio& _A)
+{
+	if (SDL_AtomicGet(&_A.Ready) & AUDIO_SNAPSHOT_NEW) {
+		_A.Read = SDL_AtomicSet(&_A.Ready, _A.Read) & ~AUDIO_SNAPSHOT_NEW;
+		SDL_MemoryBarrierAcquire();
+	}
+	return _A.Snapshots[_A.Read];
 }
 
-static void Mgr_Play(SMgrState& _State, ALuint _Buf, float _dB, bool _Direct=false)
+// every command pushed so far is executed and no one shot plays.
+static bool Audio_Idle(const SAudio& _A, const SAudioSnapshot& _S)
 {
-	if (_State.cAvail == 0) {
-		ERR("Too many sounds\n");
-		return;
+	return _S.cExecuted == _A.cPushed && _S.cOneShots == 0 && _S.cPending == 0;
+}
+
+// the handle is given here in a slot the audio thread gave back, Mgr_Play keeps it.
+// without a slot left the sound still plays, with no handle.
+static HMgrSound Audio_PushPlay(SAudio& _A, SAudioCommand& _C)
+{
+	Uint16 slot;
+	while (Ring_Pop(_A.Mgr->Released, &slot)) {
+		_A.FreeSlots[_A.cFreeSlots] = slot;	_A.cFreeSlots++;
+	}
+	_C.play.handle = 0;
+	if (_A.cFreeSlots == 0) {
+		Audio_Push(_A, _C);
+		return 0;
+	}
+
+	slot = _A.FreeSlots[_A.cFreeSlots-1];	_A.cFreeSlots--;
+	Uint32 gen = (_A.Generations[slot] + 1) & ((1u << (32 - MGR_HANDLE_SLOT_BITS)) - 1);
+	_A.Generations[slot] = gen ? gen : 1;
+	_C.play.handle = _A.Generations[slot] << MGR_HANDLE_SLOT_BITS | slot;
+	if (!Audio_Push(_A, _C)) {
+		_A.FreeSlots[_A.cFreeSlots] = slot;	_A.cFreeSlots++;
+		return 0;
 	}
+	return _C.play.handle;
+}
+
+static HMgrSound Audio_Play(SAudio& _A, const SSound& _Sound, float _dB, bool _Direct=false, int _Priority=MGR_PRIORITY_NORMAL, int _Group=0)
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_PLAY;
+	C.play.sound = &_Sound;
+	C.play.dB = _dB;
+	C.play.direct = _Direct;
+	C.play.priority = _Priority;
+	C.play.group = _Group;
+	return Audio_PushPlay(_A, C);
+}
+static HMgrSound Audio_Play(SAudio& _A, const SSound& _Sound, float _dB, const float _Pos[3], float _Radius=0, int _Priority=MGR_PRIORITY_NORMAL, int _Group=0)
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_PLAY;
+	C.play.sound = &_Sound;
+	C.play.dB = _dB;
+	memcpy(C.play.pos, _Pos, sizeof(C.play.pos));
+	C.play.radius = _Radius;
+	C.play.priority = _Priority;
+	C.play.group = _Group;
+	return Audio_PushPlay(_A, C);
+}
 
-	ALuint s = _State.Avail[_State.cAvail-1];	_State.cAvail--;
-	_State.Active[_State.cActive] = s;			_State.cActive++;
+// ns, the clock of Mgr_Play times extrapolated from the last snapshot.
+static Sint64 Audio_Clock(const SAudioSnapshot& _S)
+{
+	return _S.Clock + (Sint64)((SDL_GetPerformanceCounter() - _S.ClockCounter) * 1000000000.0 / SDL_GetPerformanceFrequency());
+}
 
-	alSourcei(s, AL_BUFFER, _Buf);
-	alSourcef(s, AL_GAIN, FromDecibel(_dB));
-	alSourcei(s, AL_LOOPING, AL_FALSE);
-	alSourcei(s, AL_DIRECT_CHANNELS_SOFT, _Direct?AL_TRUE:AL_FALSE);
-	alSourcef(s, AL_SOURCE_RADIUS, 0);
-	alSource3f(s, AL_POSITION, 0, 0, 0);
-	alSource3f(s, AL_VELOCITY, 0, 0, 0);
+// started at _At on the clock, to the sample with AL_SOFT_source_start_delay.
+// the plays of a sequence can be pushed at once, ahead.
+static HMgrSound Audio_PlayAt(SAudio& _A, Sint64 _At, const SSound& _Sound, float _dB, bool _Direct=false, int _Group=0)
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_PLAY;
+	C.play.sound = &_Sound;
+	C.play.dB = _dB;
+	C.play.direct = _Direct;
+	C.play.priority = MGR_PRIORITY_NORMAL;
+	C.play.group = _Group;
+	C.play.at = _At;
+	return Audio_PushPlay(_A, C);
+}
 
-	alSourcePlay(s);
+// _Max instances (0: no limit), plays of the same sound within _Window ms coalesced.
+static void Audio_SetGroup(SAudio& _A, int _Group, int _Max, Uint32 _Window)
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_GROUP;
+	C.group.index = _Group;
+	C.group.max = _Max;
+	C.group.window = _Window;
+	Audio_Push(_A, C);
 }
-static void Mgr_Play(SMgrState& _State, ALuint _Buf, float _dB, const float _Pos[3], float _Radius=0)
+
+static void Audio_StopSound(SAudio& _A, HMgrSound _Handle)
 {
-	if (_State.cAvail == 0) {
-		ERR("Too many sounds\n");
-		return;
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_STOP_SOUND;
+	C.sound.handle = _Handle;
+	Audio_Push(_A, C);
+}
+
+// the ramp runs on the audio thread, only the target is sent.
+static void Audio_SetSoundGain(SAudio& _A, HMgrSound _Handle, float _dB, Uint32 _Ramp=0, int _Curve=MGR_CURVE_EXP)
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_SOUND_GAIN;
+	C.sound.handle = _Handle;
+	C.sound.dB = _dB;
+	C.sound.ramp = _Ramp;
+	C.sound.curve = _Curve;
+	Audio_Push(_A, C);
+}
+
+static void Audio_SetSoundPosition(SAudio& _A, HMgrSound _Handle, const float _Pos[3])
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_SOUND_POSITION;
+	C.sound.handle = _Handle;
+	memcpy(C.sound.pos, _Pos, sizeof(C.sound.pos));
+	Audio_Push(_A, C);
+}
+
+// from the last snapshot: -1 once over (or not started yet).
+static float Audio_SoundOffset(const SAudioSnapshot& _S, HMgrSound _Handle)
+{
+	for (int i = 0; _Handle != 0 && i < _S.cSounds; i++) {
+		if (_S.sounds[i].handle == _Handle)
+			return _S.sounds[i].offset;
 	}
+	return -1.f;
+}
+
+// sent when changed since the last call.
+static void Audio_SetEmitter(SAudio& _A, int _Index, const SEmitterParams& _Params, SEmitterParams& _Sent)
+{
+	if (memcmp(&_Params, &_Sent, sizeof(_Params)) == 0)
+		return;
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_EMITTER;
+	C.emitter.index = _Index;
+	C.emitter.params = _Params;
+	Audio_Push(_A, C);
+	_Sent = _Params;
+}
+
+static void Audio_SetActive(SAudio& _A, int _First, int _Count, bool _Active)
+{
+	SAudioCommand C;
+	memset(&C, 0, sizeof(C));
+	C.type = AUDIO_CMD_ACTIVE;
+	C.range.first = _First;
+	C.range.count = _Count;
+	C.range.active = _Active;
+	Audio_Push(_A, C);
+}
+
 
-	ALuint s = _State.Avail[_State.cAvail-1];	_State.cAvail--;
-	_State.Active[_State.cActive] = s;			_State.cActive++;
+// ------------------- emitter motion -------------------------
+#define MOTION_HZ 1000			// steps of the simulation, whatever the frame rate
+#define MOTION_MAX_STEPS 250	// per advance, the clock skips the rest of a stall
+#define MOTION_FOLLOW_MS 50.f	// moved by hand: catches up with the target in about that
 
-	alSourcei(s, AL_BUFFER, _Buf);
-	alSourcef(s, AL_GAIN, FromDecibel(_dB));
-	alSourcei(s, AL_LOOPING, AL_FALSE);
-	alSourcei(s, AL_DIRECT_CHANNELS_SOFT, AL_FALSE);
-	alSourcef(s, AL_SOURCE_RADIUS, _Radius);
-	alSource3f(s, AL_POSITION, _Pos[0], _Pos[1], _Pos[2]);
-	alSource3f(s, AL_VELOCITY, 0, 0, 0);
+// where a path is at _t seconds.
+typedef void (*FMotionPath)(double _t, float _Pos[3]);
 
-	alSourcePlay(s);
+// an emitter moved at a fixed step: the velocity is the one of the steps, not of the frames,
+// and the audio thread carries the position along it until the next frame (SEmitterParams::time).
+struct SMotion {
+	float	pos[3];
+	float	vel[3];
+	Uint64	start;		// SDL_GetPerformanceCounter of step 0, 0: not started
+	Uint64	step;
+	Uint32	time;		// SDL_GetTicks of the last advance
+};
+
+static void Motion_Step(SMotion& _M, FMotionPath _Path, const float _Target[3])
+{
+	const float dt = 1.f / MOTION_HZ;
+	float pos[3];
+	_M.step++;
+	if (_Path) {
+		_Path(_M.step * (double)dt, pos);
+	} else {
+		const float k = 1.f - expf(-1000.f * dt / MOTION_FOLLOW_MS);
+		for (int c = 0; c < 3; c++)
+			pos[c] = _M.pos[c] + (_Target[c] - _M.pos[c]) * k;
+	}
+	for (int c = 0; c < 3; c++) {
+		_M.vel[c] = (pos[c] - _M.pos[c]) / dt;
+		_M.pos[c] = pos[c];
+	}
+}
+
+// steps up to now along _Path, or toward _Target without one.
+static void Motion_Advance(SMotion& _M, FMotionPath _Path, const float _Target[3])
+{
+	const Uint64 now = SDL_GetPerformanceCounter();
+	if (_M.start == 0) {
+		_M.start = now;
+		memcpy(_M.pos, _Target, sizeof(_M.pos));
+	}
+	const Uint64 due = (now - _M.start) * MOTION_HZ / SDL_GetPerformanceFrequency();
+	if (due - _M.step > MOTION_MAX_STEPS)
+		_M.step = due - MOTION_MAX_STEPS;
+	while (_M.step < due)
+		Motion_Step(_M, _Path, _Target);
+	_M.time = SDL_GetTicks();
+}
+
+static void Motion_Apply(const SMotion& _M, SEmitterParams& _Params)
+{
+	memcpy(_Params.pos, _M.pos, sizeof(_Params.pos));
+	memcpy(_Params.vel, _M.vel, sizeof(_Params.vel));
+	_Params.time = _M.time;
 }
 
 
@@ -327,7 +2371,8 @@ int main(int, char**)
 			return 1;
 		}
 
-		alc_ctx = alcCreateContext(alc_device, NULL);
+		const ALCint attrs[] = { ALC_MONO_SOURCES, DMonoSources, ALC_STEREO_SOURCES, DStereoSources, 0 };
+		alc_ctx = alcCreateContext(alc_device, attrs);
 		if(alc_ctx == NULL || alcMakeContextCurrent(alc_ctx) == ALC_FALSE)
 		{
 			if(alc_ctx != NULL)
@@ -348,6 +2393,19 @@ int main(int, char**)
 		al_ext = alGetString(AL_EXTENSIONS);
 	}
 
+	if (!Stream_Init() || !Loader_Init()) {
+		ERR("Could not start the stream and loader threads.\n");
+		return 1;
+	}
+	if (!Sound_MountPack(DResourcesPack, DResourcesRoot))
+		ERR("No sound pack, loading from %s\n", DResourcesRoot);
+	Bank_Init(DResourcesRoot, 8*1024*1024, SOUND_RESAMPLE);
+	ScanBank(DResourcesRoot);
+	if (!Watch_Init(DResourcesRoot))
+		ERR("No hot reload of %s\n", DResourcesRoot);
+	if (!Cache_Init(DResourcesCache))
+		ERR("No decoded cache in %s\n", DResourcesCache);
+
 	// Load resource
 	SResources Resources;
 	{
@@ -359,31 +2417,65 @@ int main(int, char**)
 	}
 
 	// openal sources
-	SMgrState MgrState;
-	SEmitter* SpatialEmit;
-	SEmitter* AmbiantLoop;
+	// openal sources, then owned by the audio thread: emitters are changed through their params.
+	static SMgrState MgrState;
+	SEmitterParams SpatialEmit, SpatialSent;
+	SEmitterParams AmbiantLoop, AmbiantSent;
+	const int SpatialIndex = 0, AmbiantIndex = 1;
 	{
-		Mgr_Init(MgrState);
-
-		SpatialEmit = &MgrState.Emitters[0];
-		AmbiantLoop = &MgrState.Emitters[1];
+		Mgr_Init(MgrState, alc_device);
+
+		SEmitter* E = Mgr_AddEmitter(MgrState);
+		memset(&SpatialEmit, 0, sizeof(SpatialEmit));
+		Mgr_SetSound(*E, &Resources.monoloop);
+		E->loop = true;
+		E->direct = false;
+		SpatialEmit.active = false;
+		SpatialEmit.dB = 0.f;
+		SpatialEmit.pos[0] = .5f;
+		SpatialEmit.pos[1] = .75f;
+		SpatialEmit.pos[2] = -3;
+		SpatialEmit.radius = 0.01f;
+		SpatialEmit.ramp = 50;		// (slider drags)
+		SpatialEmit.curve = MGR_CURVE_EXP;
+		Mgr_SetParams(MgrState, *E, SpatialEmit);
+		SpatialSent = SpatialEmit;
+
+		E = Mgr_AddEmitter(MgrState);
+		memset(&AmbiantLoop, 0, sizeof(AmbiantLoop));
+		E->direct = true;
+		Mgr_SetStream(MgrState, *E, Resources.stream_stereoloop);
+		AmbiantLoop.active = false;
+		AmbiantLoop.dB = -9.f;
+		AmbiantLoop.ramp = 50;
+		AmbiantLoop.curve = MGR_CURVE_EXP;
+		Mgr_SetParams(MgrState, *E, AmbiantLoop);
+		AmbiantSent = AmbiantLoop;
+	}
 
-		alSourcei(SpatialEmit->Source, AL_BUFFER, Resources.albuf_monoloop);
-		alSourcei(SpatialEmit->Source, AL_LOOPING, AL_TRUE);
-		alSourcei(SpatialEmit->Source, AL_DIRECT_CHANNELS_SOFT, AL_FALSE);
-		SpatialEmit->active = false;
-		SpatialEmit->dB = 0.f;
-		SpatialEmit->pos[0] = .5f;
-		SpatialEmit->pos[1] = .75f;
-		SpatialEmit->pos[2] = -3;
-		SpatialEmit->radius = 0.01f;
+	// a swarm of mosquitoes around the listener, only the closest get a source.
+	static const int SwarmSize = 10000;
+	const int SwarmFirst = MgrState.cEmitters;
+	for (int i = 0; i < SwarmSize; i++) {
+		SEmitter* E = Mgr_AddEmitter(MgrState);
+		float a = 2*PI * rand() / RAND_MAX, dist = 2.f + 48.f * rand() / RAND_MAX;
+		Mgr_SetSound(*E, &Resources.monoloop);
+		E->loop = true;
+		SEmitterParams P;
+		memset(&P, 0, sizeof(P));
+		P.dB = -12.f;
+		P.pos[0] = dist * sinf(a);
+		P.pos[2] = -dist * cosf(a);
+		P.radius = 0.01f;
+		Mgr_SetParams(MgrState, *E, P);
+	}
 
-		alSourcei(AmbiantLoop->Source, AL_BUFFER, Resources.albuf_stereoloop);
-		alSourcei(AmbiantLoop->Source, AL_LOOPING, AL_TRUE);
-		alSourcei(AmbiantLoop->Source, AL_DIRECT_CHANNELS_SOFT, AL_TRUE);
-		AmbiantLoop->active = false;
-		AmbiantLoop->dB = -9.f;
+	static SAudio Audio;
+	if (!Audio_Start(Audio, MgrState, Resources, DAudioRate)) {
+		ERR("Could not start the audio thread.\n");
+		return 1;
 	}
+	Audio_SetGroup(Audio, DGroupBurst, 4, 50);
 
 	// Main loop
 	bool done = false;
@@ -396,8 +2488,15 @@ int main(int, char**)
 			if (event.type == SDL_QUIT)
 				done = true;
 		}
-		uint CurTimeMs = SDL_GetTicks();
-		int ActiveSources = Mgr_Update(MgrState);
+		while (const char* changed = Watch_Next()) {
+			SAudioCommand C;
+			memset(&C, 0, sizeof(C));
+			C.type = AUDIO_CMD_RELOAD;
+			strncpy(C.name, changed, sizeof(C.name)-1);
+			Audio_Push(Audio, C);
+		}
+		UpdateResources(Resources);
+		const SAudioSnapshot& Snap = Audio_Snapshot(Audio);
 
 		ImGui_ImplSdl_NewFrame(sdl_window);
 
@@ -437,6 +2536,184 @@ int main(int, char**)
 
 		ImGui::Spacing();	// -----------------
 
+		// Resources
+		if (ImGui::CollapsingHeader("Resources"))
+		{
+			static const bool LoopPoints = alIsExtensionPresent("AL_SOFT_loop_points");
+			SSound* Sounds[8];
+			int cSounds = ResourcesSounds(Resources, Sounds);
+			ImGui::Columns(5, "Resources");
+			for (int i = 0; i < cSounds; i++) {
+				const SSound& S = *Sounds[i];
+				const char* name = strrchr(S.path, '/');
+				int state = Sound_State(S);
+				ImGui::Text("%s", name ? name+1 : S.path);		ImGui::NextColumn();
+				ImGui::Text("%s", Sound_StateName(state));		ImGui::NextColumn();
+				if (state == SOUND_READY) {
+					ALint freq = 0, loop[2] = { 0, 0 };
+					alGetBufferi(S.buffer, AL_FREQUENCY, &freq);
+					if (LoopPoints)
+						alGetBufferiv(S.buffer, AL_LOOP_POINTS_SOFT, loop);
+					ImGui::Text("%llu KB", (unsigned long long)S.load.bytes/1024);	ImGui::NextColumn();
+					ImGui::Text("%.2f ms", S.load.seconds*1000.);					ImGui::NextColumn();
+					if (loop[0] > 0)
+						ImGui::Text("%d Hz, loop %d-%d", freq, loop[0], loop[1]);
+					else
+						ImGui::Text("%d Hz", freq);
+					ImGui::NextColumn();
+				} else {
+					ImGui::NextColumn();
+					ImGui::NextColumn();
+					ImGui::NextColumn();
+				}
+			}
+			ImGui::Columns(1);
+			ImGui::Text("mix rate: %d Hz, %s", Snap.MixFreq, Snap.FastResampler ? "linear resampler at the mix rate" : "default resampler");
+			if (Sound_PackedCount() >= 0)
+				ImGui::Text("pack: %d sounds, single mapping", Sound_PackedCount());
+			else
+				ImGui::Text("pack: none, individual files");
+			ImGui::Text("hot reload: %d files", Snap.reloads);
+			if (Resources.load_wall > 0)
+				ImGui::Text("startup: %.1f ms wall clock, %.1f ms decoding, %s (%d/%d from the cache)", Resources.load_wall*1000., Resources.load.seconds*1000.,
+					Resources.load.cached > 0 ? "warm" : "cold", Resources.load.cached, cSounds);
+			else
+				ImGui::Text("loading...");
+
+			// the same loads converted again, then from the cache.
+			static SSound BenchSounds[8];
+			static int BenchPhase = -1;
+			static Uint64 BenchStart = 0;
+			static double BenchWall[2] = { 0, 0 };
+			static SLoadStats BenchLoad[2];
+			if (BenchPhase >= 0) {
+				bool settled = true;
+				SLoadStats load = { 0, 0, 0 };
+				for (int i = 0; i < cSounds; i++) {
+					int state = Sound_State(BenchSounds[i]);
+					settled = settled && (state == SOUND_READY || state == SOUND_FAILED);
+					load.bytes += BenchSounds[i].load.bytes;
+					load.seconds += BenchSounds[i].load.seconds;
+					load.cached += BenchSounds[i].load.cached;
+				}
+				if (settled) {
+					BenchWall[BenchPhase] = (double)(SDL_GetPerformanceCounter() - BenchStart) / SDL_GetPerformanceFrequency();
+					BenchLoad[BenchPhase] = load;
+					for (int i = 0; i < cSounds; i++)
+						Loader_Free(BenchSounds[i]);
+					BenchPhase = BenchPhase == 0 ? 1 : -1;
+					if (BenchPhase == 1) {
+						BenchStart = SDL_GetPerformanceCounter();
+						for (int i = 0; i < cSounds; i++)
+							Loader_Load(BenchSounds[i], Sounds[i]->path, Sounds[i]->flags);
+					}
+				}
+			}
+			if (!Cache_Enabled()) {
+				ImGui::Text("decoded cache: none");
+			} else if (BenchPhase < 0) {
+				if (ImGui::SmallButton("measure cold vs warm")) {
+					BenchPhase = 0;
+					BenchStart = SDL_GetPerformanceCounter();
+					for (int i = 0; i < cSounds; i++)
+						Loader_Load(BenchSounds[i], Sounds[i]->path, Sounds[i]->flags | SOUND_NOCACHE);
+				}
+				if (BenchWall[1] > 0) {
+					for (int i = 0; i < 2; i++)
+						ImGui::Text("%s: %.1f ms wall clock, %.1f ms decoding, %d/%d from the cache", i == 0 ? "cold" : "warm",
+							BenchWall[i]*1000., BenchLoad[i].seconds*1000., BenchLoad[i].cached, cSounds);
+				}
+			} else {
+				ImGui::Text("measuring %s...", BenchPhase == 0 ? "cold" : "warm");
+			}
+		}
+
+		ImGui::Spacing();	// -----------------
+
+		// PCM vs IMA4 buffers
+		if (ImGui::CollapsingHeader("ADPCM"))
+		{
+			// a burst of voices of one variant, cpu measured until they all ended.
+			static int BenchVariant = -1;
+			static double BenchCpu0 = 0;
+			static Uint64 BenchWall0 = 0;
+			static float BenchCpu[2] = { 0, 0 };
+			if (BenchVariant >= 0 && Audio_Idle(Audio, Snap)) {
+				double wall = (double)(SDL_GetPerformanceCounter() - BenchWall0) / SDL_GetPerformanceFrequency();
+				BenchCpu[BenchVariant] = wall > 0 ? 100.f * (ProcessCpuSeconds() - BenchCpu0) / wall : 0;
+				BenchVariant = -1;
+			}
+
+			const SSound* Variants[2] = { &Resources.stereo, &Resources.stereo_adpcm };
+			ImGui::Columns(3, "ADPCM");
+			ImGui::Text("bark.wav");	ImGui::NextColumn();	ImGui::Text("PCM");		ImGui::NextColumn();	ImGui::Text("IMA4");	ImGui::NextColumn();
+			ImGui::Separator();
+			ImGui::Text("AL memory");	ImGui::NextColumn();
+			for (int i = 0; i < 2; i++) {
+				ALint size = 0;
+				if (Sound_State(*Variants[i]) == SOUND_READY)
+					alGetBufferi(Variants[i]->buffer, AL_SIZE, &size);
+				ImGui::Text("%d KB", size/1024);		ImGui::NextColumn();
+			}
+			ImGui::Text("load");		ImGui::NextColumn();
+			for (int i = 0; i < 2; i++) {
+				ImGui::Text("%.2f ms", Variants[i]->load.seconds*1000.);		ImGui::NextColumn();
+			}
+			ImGui::Text("16 voices cpu");	ImGui::NextColumn();
+			for (int i = 0; i < 2; i++) {
+				char label[32];
+				snprintf(label, sizeof(label), "Play x16##adpcm%d", i);
+				if (ImGui::Button(label) && BenchVariant < 0) {
+					BenchVariant = i;
+					BenchCpu0 = ProcessCpuSeconds();
+					BenchWall0 = SDL_GetPerformanceCounter();
+					for (int v = 0; v < 16; v++)
+						Audio_Play(Audio, *Variants[i], -18.f, true);
+				}
+				ImGui::SameLine();
+				ImGui::Text("%.1f %%", BenchCpu[i]);	ImGui::NextColumn();
+			}
+			ImGui::Columns(1);
+			ImGui::TextDisabled("process cpu time over wall time, UI and mixer thread included");
+		}
+
+		ImGui::Spacing();	// -----------------
+
+		// Bank
+		if (ImGui::CollapsingHeader("Bank"))
+		{
+			static int BudgetKB = 8*1024;
+			if (ImGui::SliderInt("budget", &BudgetKB, 0, 64*1024, "%.0f KB")) {
+				SAudioCommand C;
+				memset(&C, 0, sizeof(C));
+				C.type = AUDIO_CMD_BUDGET;
+				C.budget = (Uint64)BudgetKB*1024;
+				Audio_Push(Audio, C);
+			}
+
+			const SBankStats& stats = Snap.bank;
+			ImGui::Text("%d / %d resident, %llu / %llu KB", stats.cResident, stats.cSounds, (unsigned long long)stats.resident/1024, (unsigned long long)stats.budget/1024);
+			ImGui::Text("%d evictions, %d reloads", stats.cEvictions, stats.cReloads);
+
+			ImGui::Columns(5, "Bank");
+			for (int i = 0; i < stats.cSounds; i++) {
+				const SBankInfo& info = Snap.bank_sounds[i];
+				const char* name = strrchr(info.sound->path, '/');
+				ImGui::PushID(i);
+				if (ImGui::SmallButton("play"))
+					Audio_Play(Audio, *info.sound, -6.f, true);
+				ImGui::NextColumn();
+				ImGui::Text("%s", name ? name+1 : info.sound->path);			ImGui::NextColumn();
+				ImGui::Text("%s", Sound_StateName(Sound_State(*info.sound)));	ImGui::NextColumn();
+				ImGui::Text("%d refs", info.refs);								ImGui::NextColumn();
+				ImGui::Text("%u KB", info.bytes/1024);							ImGui::NextColumn();
+				ImGui::PopID();
+			}
+			ImGui::Columns(1);
+		}
+
+		ImGui::Spacing();	// -----------------
+
 		// basic test
 		if (ImGui::CollapsingHeader("Basic", NULL, true, true))
 		{
@@ -445,14 +2722,14 @@ int main(int, char**)
 
 			if (ImGui::Button("Play mono"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_mono, mono_gaindB);
+				Audio_Play(Audio, Resources.mono, mono_gaindB);
 			}
 			ImGui::SameLine();
 			ImGui::SliderFloat("##vol1", &mono_gaindB, -60, 6, "%.1fdB");
 
 			if (ImGui::Button("Play stereo"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_stereo, stereo_gaindB);
+				Audio_Play(Audio, Resources.stereo, stereo_gaindB);
 			}
 			ImGui::SameLine();
 			ImGui::SliderFloat("##vol2", &stereo_gaindB, -60, 6, "%.1fdB");
@@ -463,54 +2740,63 @@ int main(int, char**)
 		// Direct
 		if (ImGui::CollapsingHeader("Direct", NULL, true, true))
 		{
-			ImGui::Checkbox("Ambiance", &AmbiantLoop->active);
+			ImGui::Checkbox("Ambiance", &AmbiantLoop.active);
 			ImGui::SameLine();
-			ImGui::SliderFloat("##vol0", &AmbiantLoop->dB, -60, 6, "%.1fdB");
+			ImGui::SliderFloat("##vol0", &AmbiantLoop.dB, -60, 6, "%.1fdB");
+			ImGui::TextDisabled("streamed, %d KB resident", Stream_ResidentBytes(Resources.stream_stereoloop)/1024);
 		}
 
 		ImGui::Spacing();	// -----------------
 
 		// Spatialized
+		// moved on the motion clock, the edited position is where it heads to by hand.
+		static SMotion SpatialMotion;
+		static bool automove = false;
+		{
+			struct SLocal {
+				static void anim(double s, float v[3]) {
+					float w = (float)(fmod(s, 60.) / 60. * 2*PI);
+					v[0] = 5*sinf(w*2+1) + 3*sinf(w*6+2) + 2*sinf(w*6+3) + 1*sinf(w*9+4);
+					v[1] = 5*sinf(w*3+5) + 3*sinf(w*4+6) + 2*sinf(w*7+7) + 1*sinf(w*8+8);
+					v[2] = 5*sinf(w*4+9) + 3*sinf(w*5+1) + 2*sinf(w*8+2) + 1*sinf(w*7+3);
+				}
+			};
+			Motion_Advance(SpatialMotion, automove ? SLocal::anim : NULL, SpatialEmit.pos);
+			if (automove)
+				memcpy(SpatialEmit.pos, SpatialMotion.pos, sizeof(SpatialEmit.pos));
+			memcpy(SpatialEmit.vel, SpatialMotion.vel, sizeof(SpatialEmit.vel));
+		}
 		if (ImGui::CollapsingHeader("Spatialized", NULL, true, true))
 		{
-			ImGui::Checkbox("Mosquito", &SpatialEmit->active);
+			ImGui::Checkbox("Mosquito", &SpatialEmit.active);
 			ImGui::SameLine();
-			ImGui::SliderFloat("##vol4", &SpatialEmit->dB, -60, 6, "%.1fdB");
-			ImGui::SliderFloat("radius", &SpatialEmit->radius, 0, 5);
-
-			static uint PrevTime = 0;
-			static float PrevPos[3];
-			static bool automove = false;
+			ImGui::SliderFloat("##vol4", &SpatialEmit.dB, -60, 6, "%.1fdB");
+			ImGui::SliderFloat("radius", &SpatialEmit.radius, 0, 5);
 			ImGui::Checkbox("Auto move", &automove);
-			if (automove) {
-				struct SLocal {
-					static void anim(float t, float v[3]) {
-						float w = (t*2*PI);
-						v[0] = 5*sinf(w*2+1) + 3*sinf(w*6+2) + 2*sinf(w*6+3) + 1*sinf(w*9+4);
-						v[1] = 5*sinf(w*3+5) + 3*sinf(w*4+6) + 2*sinf(w*7+7) + 1*sinf(w*8+8);
-						v[2] = 5*sinf(w*4+9) + 3*sinf(w*5+1) + 2*sinf(w*8+2) + 1*sinf(w*7+3);
-					}
-				};
-
-				float t = (CurTimeMs % 60000) / 60000.f;
-				SLocal::anim(t, SpatialEmit->pos);
-			}
 
-			ImGui::InputFloat3("pos", SpatialEmit->pos);
-			ImGui::InputFloat3("vel", SpatialEmit->vel);
-			ImGuiPointOnMap("top", &SpatialEmit->pos[0], &SpatialEmit->pos[2], SpatialEmit->radius, 10, 0.25f);
+			ImGui::InputFloat3("pos", SpatialEmit.pos);
+			ImGui::Text("vel: %.2f %.2f %.2f, at %d Hz", SpatialEmit.vel[0], SpatialEmit.vel[1], SpatialEmit.vel[2], MOTION_HZ);
+			ImGuiPointOnMap("top", &SpatialEmit.pos[0], &SpatialEmit.pos[2], SpatialEmit.radius, 10, 0.25f);
 			ImGui::SameLine();
-			ImGuiPointOnMap("front", &SpatialEmit->pos[0], &SpatialEmit->pos[1], SpatialEmit->radius, 10, 0.25f);
-
-			if (PrevTime != 0 && CurTimeMs > PrevTime) {
-				float dt = 0.001f*(CurTimeMs-PrevTime);
-				float k = 1.f;
-				SpatialEmit->vel[0] = k * ((SpatialEmit->pos[0] - PrevPos[0]) / dt);
-				SpatialEmit->vel[1] = k * ((SpatialEmit->pos[1] - PrevPos[1]) / dt);
-				SpatialEmit->vel[2] = k * ((SpatialEmit->pos[2] - PrevPos[2]) / dt);
+			ImGuiPointOnMap("front", &SpatialEmit.pos[0], &SpatialEmit.pos[1], SpatialEmit.radius, 10, 0.25f);
+		}
+
+		ImGui::Spacing();	// -----------------
+
+		// Virtual voices
+		if (ImGui::CollapsingHeader("Virtual voices"))
+		{
+			static int SwarmActive = 0;
+			int prev = SwarmActive;
+			if (ImGui::SliderInt("swarm", &SwarmActive, 0, SwarmSize, "%.0f emitters")) {
+				if (SwarmActive > prev)
+					Audio_SetActive(Audio, SwarmFirst + prev, SwarmActive - prev, true);
+				else if (SwarmActive < prev)
+					Audio_SetActive(Audio, SwarmFirst + SwarmActive, prev - SwarmActive, false);
 			}
-			PrevTime = CurTimeMs;
-			memcpy(PrevPos, SpatialEmit->pos, sizeof(PrevPos));
+			ImGui::Text("%d with a source, %d virtual / %d emitters", Snap.cBound, Snap.cVirtual, Snap.cEmitters);
+			ImGui::Text("lod: %d full, %d without doppler, %d at a fixed direction", Snap.cLod[MGR_LOD_FULL], Snap.cLod[MGR_LOD_PAN], Snap.cLod[MGR_LOD_CENTER]);
+			ImGui::Text("audibility pass: %.1f us, %d emitters in range", Snap.ScoreUs, Snap.cScored);
 		}
 
 		ImGui::Spacing();	// -----------------
@@ -519,47 +2805,124 @@ int main(int, char**)
 		if (ImGui::CollapsingHeader("Tests", NULL, true, true))
 		{
 			static const float Front[3] = {0,0,-1};
+			static HMgrSound Moving = 0;		// the last 3d play, moved around with its handle
+			static float MovingAngle = 0;
 			if (ImGui::Button("stereo base"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_stereo, -3, false);
+				Audio_Play(Audio, Resources.stereo, -3, false);
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("stereo direct"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_stereo, -3, true);
+				Audio_Play(Audio, Resources.stereo, -3, true);
 			}
 			if (ImGui::Button("mono base"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_mono, -3, false);
+				Audio_Play(Audio, Resources.mono, -3, false);
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("mono direct"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_mono, -3, true);
+				Audio_Play(Audio, Resources.mono, -3, true);
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("mono 3d narrow"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_mono, -3, Front, 0.01f);
+				Moving = Audio_Play(Audio, Resources.mono, -3, Front, 0.01f);
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("mono 3d wide"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_mono, -3, Front, 1.f);
+				Moving = Audio_Play(Audio, Resources.mono, -3, Front, 1.f);
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("mono 3d omni"))
 			{
-				Mgr_Play(MgrState, Resources.albuf_mono, -3, Front, 10.f);
+				Moving = Audio_Play(Audio, Resources.mono, -3, Front, 10.f);
+			}
+
+			// more plays than sources: the farthest get stolen, then the new far ones dropped.
+			if (ImGui::Button("burst x48"))
+			{
+				for (int i = 0; i < 48; i++) {
+					float a = i * 2*PI / 48, dist = 1.f + (i % 8) * 2.f;
+					float pos[3] = { dist*sinf(a), 0, -dist*cosf(a) };
+					Audio_Play(Audio, Resources.mono, -9, pos, 0.01f, MGR_PRIORITY_LOW);
+				}
 			}
+			ImGui::SameLine();
+			// fifty triggers in a frame: a single voice, a bit louder.
+			if (ImGui::Button("grouped x50"))
+			{
+				for (int i = 0; i < 50; i++)
+					Audio_Play(Audio, Resources.mono, -12, true, MGR_PRIORITY_NORMAL, DGroupBurst);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("mono high priority"))
+			{
+				Audio_Play(Audio, Resources.mono, -3, true, MGR_PRIORITY_HIGH);
+			}
+			ImGui::Text("stolen: %d, dropped: %d", Snap.cStolen, Snap.cDropped);
+			ImGui::Text("grouped: %d coalesced, %d over the limit", Snap.cCoalesced, Snap.cLimited);
+
+			// pushed in one go, each on its beat whatever the UI frame rate.
+			if (ImGui::Button("sequence x16"))
+			{
+				const Sint64 start = Audio_Clock(Snap) + 100000000;
+				for (int i = 0; i < 16; i++)
+					Audio_PlayAt(Audio, start + i * 125000000ll, Resources.mono, i % 4 ? -15.f : -9.f, true);
+			}
+			ImGui::SameLine();
+			ImGui::Text("%s clock, %s", Snap.DeviceClock ? "device" : "software", Snap.StartDelay ? "started by the mixer" : "started by the audio thread");
+
+			const float offset = Audio_SoundOffset(Snap, Moving);
+			if (offset >= 0) {
+				MovingAngle += ImGui::GetIO().DeltaTime * PI;
+				const float pos[3] = { sinf(MovingAngle), 0, -cosf(MovingAngle) };
+				Audio_SetSoundPosition(Audio, Moving, pos);
+				ImGui::Text("3d play: %.2f s, circling", offset);
+				ImGui::SameLine();
+				if (ImGui::Button("stop"))
+					Audio_StopSound(Audio, Moving);
+				static float MovingdB = -3;
+				if (ImGui::SliderFloat("3d play gain", &MovingdB, -30, 0, "%.1f dB"))
+					Audio_SetSoundGain(Audio, Moving, MovingdB, 50);
+			}
+		}
+
+		{
+			SEmitterParams P = SpatialEmit;
+			Motion_Apply(SpatialMotion, P);
+			Audio_SetEmitter(Audio, SpatialIndex, P, SpatialSent);
 		}
+		Audio_SetEmitter(Audio, AmbiantIndex, AmbiantLoop, AmbiantSent);
 
 		ImGui::Spacing();	// -----------------
 
 		// status
 		{
 			ImGui::Separator();
-			ImGui::Text("Active Sources: %d / %d\n", ActiveSources, MGR_MAX_SOURCES);
+			ImGui::Text("Active Sources: %d / %d\n", Snap.cPlaying, Snap.cSources);
+			ImGui::Text("one shots: %d mono, %d stereo sources", Snap.cMono, Snap.cStereo);
+			ImGui::Text("audio thread: %.0f Hz, %.2f ms / update", Snap.TickHz, Snap.UpdateMs);
+			static float ALCalls = 0;
+			ALCalls += (Snap.cALCalls - ALCalls) * .05f;
+			ImGui::Text("AL calls: %.0f / update%s", ALCalls, Snap.Deferred ? ", deferred" : "");
+			ImGui::SameLine();
+			bool Dirty = Snap.Dirty;
+			if (ImGui::Checkbox("dirty tracking", &Dirty)) {
+				SAudioCommand C;
+				memset(&C, 0, sizeof(C));
+				C.type = AUDIO_CMD_DIRTY;
+				C.dirty = Dirty;
+				Audio_Push(Audio, C);
+			}
+			if (Snap.Events)
+				ImGui::Text("one shots recycled by AL_SOFT_events: %d, %.2f ms after they stopped", Snap.cRecycled, Snap.RecycleDelay);
+			else
+				ImGui::Text("one shots recycled by polling, no AL_SOFT_events");
+			if (Resources.load.seconds > 0)
+				ImGui::Text("Loaded %.2f MB in %.1f ms (%.0f MB/s)", Resources.load.bytes/(1024.*1024.), Resources.load.seconds*1000., Resources.load.bytes/(Resources.load.seconds*1024.*1024.));
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		}
 
@@ -574,8 +2937,15 @@ int main(int, char**)
 		SDL_GL_SwapWindow(sdl_window);
 	}
 
+	Audio_Stop(Audio);
 	Mgr_Destroy(MgrState);
+	Loader_Shutdown();
 	FreeResources(Resources);
+	Bank_Shutdown();
+	Watch_Shutdown();
+	Cache_Shutdown();
+	Sound_UnmountPack();
+	Stream_Shutdown();
 
 	// OpenAL: cleanup
 	{
@@ -0,0 +1,517 @@
+// PCM format conversion kernels
+
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <AL/al.h>
+#include <AL/alext.h>
+
+#include "pcm.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define PCM_X86 1
+#include <immintrin.h>
+#define PCM_AVX2 __attribute__((target("avx2")))
+#else
+#define PCM_X86 0
+#endif
+
+static const float S16_TO_F32 = 1.f / 32768.f;
+static const float S32_TO_F32 = 1.f / 2147483648.f;
+
+// ------------------- sample traits -------------------------
+// unaligned reads from the source, every input converts to S16 or F32.
+
+static inline uint16_t Load16(const uint8_t* p)	{ uint16_t v; memcpy(&v, p, 2); return v; }
+static inline uint32_t Load32(const uint8_t* p)	{ uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint64_t Load64(const uint8_t* p)	{ uint64_t v; memcpy(&v, p, 8); return v; }
+static inline float    AsF32(uint32_t u)			{ float f; memcpy(&f, &u, 4); return f; }
+static inline double   AsF64(uint64_t u)			{ double f; memcpy(&f, &u, 8); return f; }
+
+static inline int16_t F32ToS16(float f)
+{
+	float v = f * 32768.f;
+	if (v > 32767.f)	return 32767;
+	if (v < -32768.f)	return -32768;
+	return (int16_t)lrintf(v);
+}
+
+template<int F> struct SPcmIn;
+template<> struct SPcmIn<PCM_U8> {
+	enum { Bytes = 1 };
+	static inline float   F32(const uint8_t* p)	{ return (p[0] - 128) * (1.f/128.f); }
+	static inline int16_t S16(const uint8_t* p)	{ return (int16_t)((p[0] - 128) << 8); }
+};
+template<> struct SPcmIn<PCM_S16> {
+	enum { Bytes = 2 };
+	static inline float   F32(const uint8_t* p)	{ return (int16_t)Load16(p) * S16_TO_F32; }
+	static inline int16_t S16(const uint8_t* p)	{ return (int16_t)Load16(p); }
+};
+template<> struct SPcmIn<PCM_S16BE> {
+	enum { Bytes = 2 };
+	static inline int16_t S16(const uint8_t* p)	{ return (int16_t)((p[0] << 8) | p[1]); }
+	static inline float   F32(const uint8_t* p)	{ return S16(p) * S16_TO_F32; }
+};
+template<> struct SPcmIn<PCM_S24> {
+	enum { Bytes = 3 };
+	static inline float   F32(const uint8_t* p)	{ return (int32_t)(((uint32_t)p[0]<<8) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<24)) * S32_TO_F32; }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_S24BE> {
+	enum { Bytes = 3 };
+	static inline float   F32(const uint8_t* p)	{ return (int32_t)(((uint32_t)p[2]<<8) | ((uint32_t)p[1]<<16) | ((uint32_t)p[0]<<24)) * S32_TO_F32; }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_S32> {
+	enum { Bytes = 4 };
+	static inline float   F32(const uint8_t* p)	{ return (int32_t)Load32(p) * S32_TO_F32; }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_S32BE> {
+	enum { Bytes = 4 };
+	static inline float   F32(const uint8_t* p)	{ return (int32_t)__builtin_bswap32(Load32(p)) * S32_TO_F32; }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_F32> {
+	enum { Bytes = 4 };
+	static inline float   F32(const uint8_t* p)	{ return AsF32(Load32(p)); }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_F32BE> {
+	enum { Bytes = 4 };
+	static inline float   F32(const uint8_t* p)	{ return AsF32(__builtin_bswap32(Load32(p))); }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_F64> {
+	enum { Bytes = 8 };
+	static inline float   F32(const uint8_t* p)	{ return (float)AsF64(Load64(p)); }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+template<> struct SPcmIn<PCM_F64BE> {
+	enum { Bytes = 8 };
+	static inline float   F32(const uint8_t* p)	{ return (float)AsF64(__builtin_bswap64(Load64(p))); }
+	static inline int16_t S16(const uint8_t* p)	{ return F32ToS16(F32(p)); }
+};
+
+template<int F> struct SPcmOut;
+template<> struct SPcmOut<PCM_S16> {
+	enum { Bytes = 2 };
+	template<class In> static inline void Write(uint8_t* d, const uint8_t* s) { int16_t v = In::S16(s); memcpy(d, &v, 2); }
+};
+template<> struct SPcmOut<PCM_F32> {
+	enum { Bytes = 4 };
+	template<class In> static inline void Write(uint8_t* d, const uint8_t* s) { float v = In::F32(s); memcpy(d, &v, 4); }
+};
+
+template<int Src, int Dst> static void Pcm_ConvertScalar(const uint8_t* s, uint8_t* d, size_t n)
+{
+	typedef SPcmIn<Src> In;
+	typedef SPcmOut<Dst> Out;
+	for (size_t i = 0; i < n; i++)
+		Out::template Write<In>(d + i*Out::Bytes, s + i*In::Bytes);
+}
+
+
+// ------------------- SIMD kernels -------------------------
+// each kernel converts a prefix and returns its length in samples, the scalar loop does the tail.
+
+template<int Src, int Dst> struct SPcmKernel {
+	static size_t SSE2(const uint8_t*, uint8_t*, size_t) { return 0; }
+	static size_t AVX2(const uint8_t*, uint8_t*, size_t) { return 0; }
+};
+
+#if PCM_X86
+static inline __m128i Swap16_SSE2(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+static inline __m128i Swap32_SSE2(__m128i v)
+{
+	v = Swap16_SSE2(v);
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+}
+static inline __m128i Swap64_SSE2(__m128i v)
+{
+	return _mm_shuffle_epi32(Swap32_SSE2(v), _MM_SHUFFLE(2,3,0,1));
+}
+static inline __m128i ToS16_SSE2(__m128 v)
+{
+	v = _mm_mul_ps(v, _mm_set1_ps(32768.f));
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-32768.f)), _mm_set1_ps(32767.f));
+	return _mm_cvtps_epi32(v);
+}
+
+PCM_AVX2 static inline __m256i Swap_AVX2(__m256i v, int _Bytes)
+{
+	const __m256i swap16 = _mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14, 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+	const __m256i swap32 = _mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12, 3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+	const __m256i swap64 = _mm256_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8, 7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+	return _mm256_shuffle_epi8(v, _Bytes == 2 ? swap16 : _Bytes == 4 ? swap32 : swap64);
+}
+
+// S16BE -> S16
+template<> struct SPcmKernel<PCM_S16BE, PCM_S16> {
+	static size_t SSE2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm_storeu_si128((__m128i*)(d + 2*i), Swap16_SSE2(_mm_loadu_si128((const __m128i*)(s + 2*i))));
+		return i;
+	}
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 16 <= n; i += 16)
+			_mm256_storeu_si256((__m256i*)(d + 2*i), Swap_AVX2(_mm256_loadu_si256((const __m256i*)(s + 2*i)), 2));
+		return i;
+	}
+};
+
+// S16 -> F32
+template<> struct SPcmKernel<PCM_S16, PCM_F32> {
+	static size_t SSE2(const uint8_t* s, uint8_t* d, size_t n) {
+		const __m128 k = _mm_set1_ps(S16_TO_F32);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s + 2*i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps((float*)(d + 4*i), _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+			_mm_storeu_ps((float*)(d + 4*i + 16), _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+		}
+		return i;
+	}
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		const __m256 k = _mm256_set1_ps(S16_TO_F32);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(s + 2*i)));
+			_mm256_storeu_ps((float*)(d + 4*i), _mm256_mul_ps(_mm256_cvtepi32_ps(v), k));
+		}
+		return i;
+	}
+};
+
+// F32 -> S16
+template<> struct SPcmKernel<PCM_F32, PCM_S16> {
+	static size_t SSE2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m128i lo = ToS16_SSE2(_mm_loadu_ps((const float*)(s + 4*i)));
+			__m128i hi = ToS16_SSE2(_mm_loadu_ps((const float*)(s + 4*i + 16)));
+			_mm_storeu_si128((__m128i*)(d + 2*i), _mm_packs_epi32(lo, hi));
+		}
+		return i;
+	}
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		const __m256 k = _mm256_set1_ps(32768.f);
+		const __m256 lo_clamp = _mm256_set1_ps(-32768.f);
+		const __m256 hi_clamp = _mm256_set1_ps(32767.f);
+		size_t i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m256 a = _mm256_mul_ps(_mm256_loadu_ps((const float*)(s + 4*i)), k);
+			__m256 b = _mm256_mul_ps(_mm256_loadu_ps((const float*)(s + 4*i + 32)), k);
+			a = _mm256_min_ps(_mm256_max_ps(a, lo_clamp), hi_clamp);
+			b = _mm256_min_ps(_mm256_max_ps(b, lo_clamp), hi_clamp);
+			__m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+			_mm256_storeu_si256((__m256i*)(d + 2*i), _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3,1,2,0)));
+		}
+		return i;
+	}
+};
+
+// S24 / S24BE -> F32: the 3 bytes go to the top of an int32.
+template<int Src> struct SPcmKernelS24 {
+	static size_t SSE2(const uint8_t*, uint8_t*, size_t) { return 0; }
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		const __m256i lanes = _mm256_setr_epi32(0,1,2,3, 3,4,5,6);		// bytes 0..11 | 12..23
+		const __m256i le = _mm256_setr_epi8(-1,0,1,2, -1,3,4,5, -1,6,7,8, -1,9,10,11, -1,0,1,2, -1,3,4,5, -1,6,7,8, -1,9,10,11);
+		const __m256i be = _mm256_setr_epi8(-1,2,1,0, -1,5,4,3, -1,8,7,6, -1,11,10,9, -1,2,1,0, -1,5,4,3, -1,8,7,6, -1,11,10,9);
+		const __m256 k = _mm256_set1_ps(S32_TO_F32);
+		size_t i = 0;
+		// 8 samples from a 32 bytes load: stay 8 bytes away from the end.
+		for (; i + 11 <= n; i += 8) {
+			__m256i v = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(s + 3*i)), lanes);
+			v = _mm256_shuffle_epi8(v, Src == PCM_S24 ? le : be);
+			_mm256_storeu_ps((float*)(d + 4*i), _mm256_mul_ps(_mm256_cvtepi32_ps(v), k));
+		}
+		return i;
+	}
+};
+template<> struct SPcmKernel<PCM_S24, PCM_F32> : SPcmKernelS24<PCM_S24> {};
+template<> struct SPcmKernel<PCM_S24BE, PCM_F32> : SPcmKernelS24<PCM_S24BE> {};
+
+// S32 / S32BE -> F32
+template<int Src> struct SPcmKernelS32 {
+	static size_t SSE2(const uint8_t* s, uint8_t* d, size_t n) {
+		const __m128 k = _mm_set1_ps(S32_TO_F32);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s + 4*i));
+			if (Src == PCM_S32BE)
+				v = Swap32_SSE2(v);
+			_mm_storeu_ps((float*)(d + 4*i), _mm_mul_ps(_mm_cvtepi32_ps(v), k));
+		}
+		return i;
+	}
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		const __m256 k = _mm256_set1_ps(S32_TO_F32);
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(s + 4*i));
+			if (Src == PCM_S32BE)
+				v = Swap_AVX2(v, 4);
+			_mm256_storeu_ps((float*)(d + 4*i), _mm256_mul_ps(_mm256_cvtepi32_ps(v), k));
+		}
+		return i;
+	}
+};
+template<> struct SPcmKernel<PCM_S32, PCM_F32> : SPcmKernelS32<PCM_S32> {};
+template<> struct SPcmKernel<PCM_S32BE, PCM_F32> : SPcmKernelS32<PCM_S32BE> {};
+
+// F32BE -> F32
+template<> struct SPcmKernel<PCM_F32BE, PCM_F32> {
+	static size_t SSE2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_si128((__m128i*)(d + 4*i), Swap32_SSE2(_mm_loadu_si128((const __m128i*)(s + 4*i))));
+		return i;
+	}
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_si256((__m256i*)(d + 4*i), Swap_AVX2(_mm256_loadu_si256((const __m256i*)(s + 4*i)), 4));
+		return i;
+	}
+};
+
+// F64 / F64BE -> F32
+template<int Src> struct SPcmKernelF64 {
+	static size_t SSE2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(s + 8*i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(s + 8*i + 16));
+			if (Src == PCM_F64BE) {
+				a = Swap64_SSE2(a);
+				b = Swap64_SSE2(b);
+			}
+			__m128 lo = _mm_cvtpd_ps(_mm_castsi128_pd(a));
+			__m128 hi = _mm_cvtpd_ps(_mm_castsi128_pd(b));
+			_mm_storeu_ps((float*)(d + 4*i), _mm_movelh_ps(lo, hi));
+		}
+		return i;
+	}
+	PCM_AVX2 static size_t AVX2(const uint8_t* s, uint8_t* d, size_t n) {
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)(s + 8*i));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(s + 8*i + 32));
+			if (Src == PCM_F64BE) {
+				a = Swap_AVX2(a, 8);
+				b = Swap_AVX2(b, 8);
+			}
+			__m128 lo = _mm256_cvtpd_ps(_mm256_castsi256_pd(a));
+			__m128 hi = _mm256_cvtpd_ps(_mm256_castsi256_pd(b));
+			_mm256_storeu_ps((float*)(d + 4*i), _mm256_set_m128(hi, lo));
+		}
+		return i;
+	}
+};
+template<> struct SPcmKernel<PCM_F64, PCM_F32> : SPcmKernelF64<PCM_F64> {};
+template<> struct SPcmKernel<PCM_F64BE, PCM_F32> : SPcmKernelF64<PCM_F64BE> {};
+
+static bool Pcm_HasAVX2()
+{
+	static int s_AVX2 = -1;
+	if (s_AVX2 < 0)
+		s_AVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	return s_AVX2 != 0;
+}
+#endif
+
+template<int Src, int Dst> static void Pcm_ConvertT(const uint8_t* s, uint8_t* d, size_t n)
+{
+	size_t done = 0;
+#if PCM_X86
+	done = Pcm_HasAVX2() ? SPcmKernel<Src,Dst>::AVX2(s, d, n) : SPcmKernel<Src,Dst>::SSE2(s, d, n);
+#endif
+	Pcm_ConvertScalar<Src,Dst>(s + done*SPcmIn<Src>::Bytes, d + done*SPcmOut<Dst>::Bytes, n - done);
+}
+
+template<int Dst> static bool Pcm_ConvertTo(int _Src, const uint8_t* s, uint8_t* d, size_t n)
+{
+	switch (_Src) {
+	case PCM_U8:	Pcm_ConvertT<PCM_U8, Dst>(s, d, n);		return true;
+	case PCM_S16:	Pcm_ConvertT<PCM_S16, Dst>(s, d, n);	return true;
+	case PCM_S16BE:	Pcm_ConvertT<PCM_S16BE, Dst>(s, d, n);	return true;
+	case PCM_S24:	Pcm_ConvertT<PCM_S24, Dst>(s, d, n);	return true;
+	case PCM_S24BE:	Pcm_ConvertT<PCM_S24BE, Dst>(s, d, n);	return true;
+	case PCM_S32:	Pcm_ConvertT<PCM_S32, Dst>(s, d, n);	return true;
+	case PCM_S32BE:	Pcm_ConvertT<PCM_S32BE, Dst>(s, d, n);	return true;
+	case PCM_F32:	Pcm_ConvertT<PCM_F32, Dst>(s, d, n);	return true;
+	case PCM_F32BE:	Pcm_ConvertT<PCM_F32BE, Dst>(s, d, n);	return true;
+	case PCM_F64:	Pcm_ConvertT<PCM_F64, Dst>(s, d, n);	return true;
+	case PCM_F64BE:	Pcm_ConvertT<PCM_F64BE, Dst>(s, d, n);	return true;
+	}
+	return false;
+}
+
+
+// ------------------- IMA ADPCM -------------------------
+// the encoder mirrors the decoder step by step, so the predictor never drifts from what gets played.
+
+static const int16_t s_ImaSteps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+static const int8_t s_ImaIndexes[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+struct SImaState {
+	int		predictor;
+	int		index;
+};
+
+static inline uint8_t Ima_Encode(SImaState& _State, int _Sample)
+{
+	int step = s_ImaSteps[_State.index];
+	int diff = _Sample - _State.predictor;
+	uint8_t nibble = 0;
+	if (diff < 0) { nibble = 8; diff = -diff; }
+
+	int delta = step >> 3;
+	if (diff >= step)	{ nibble |= 4; diff -= step; delta += step; }
+	step >>= 1;
+	if (diff >= step)	{ nibble |= 2; diff -= step; delta += step; }
+	step >>= 1;
+	if (diff >= step)	{ nibble |= 1; delta += step; }
+
+	_State.predictor += (nibble & 8) ? -delta : delta;
+	if (_State.predictor > 32767)	_State.predictor = 32767;
+	if (_State.predictor < -32768)	_State.predictor = -32768;
+	_State.index += s_ImaIndexes[nibble];
+	if (_State.index < 0)	_State.index = 0;
+	if (_State.index > 88)	_State.index = 88;
+	return nibble;
+}
+
+static inline int Ima_Sample(const int16_t* _Src, size_t _Frames, int _Channels, size_t _Frame, int _Channel)
+{
+	return _Frame < _Frames ? _Src[_Frame*_Channels + _Channel] : 0;
+}
+
+
+// ------------------- public -------------------------
+int Pcm_Bytes(int _Fmt)
+{
+	switch (_Fmt) {
+	case PCM_U8:							return 1;
+	case PCM_S16:	case PCM_S16BE:			return 2;
+	case PCM_S24:	case PCM_S24BE:			return 3;
+	case PCM_S32:	case PCM_S32BE:
+	case PCM_F32:	case PCM_F32BE:			return 4;
+	case PCM_F64:	case PCM_F64BE:			return 8;
+	}
+	return 0;
+}
+
+const char* Pcm_Name(int _Fmt)
+{
+	static const char* s_Names[] = { "U8", "S16", "S16BE", "S24", "S24BE", "S32", "S32BE", "F32", "F32BE", "F64", "F64BE" };
+	if (_Fmt < 0 || _Fmt > PCM_F64BE)
+		return "?";
+	return s_Names[_Fmt];
+}
+
+int Pcm_TargetFormat(int _Src)
+{
+	switch (_Src) {
+	case PCM_U8:							return PCM_U8;
+	case PCM_S16:	case PCM_S16BE:			return PCM_S16;
+	case PCM_UNKNOWN:						return PCM_UNKNOWN;
+	}
+	return PCM_F32;		// keeps the precision of 24/32 bit and double sources
+}
+
+ALenum Pcm_ALFormat(int _Fmt, int _Channels)
+{
+	static const ALenum s_Formats[][3] = {
+		//	U8						S16						F32
+		{ AL_FORMAT_MONO8,		AL_FORMAT_MONO16,		AL_FORMAT_MONO_FLOAT32 },		// 1
+		{ AL_FORMAT_STEREO8,	AL_FORMAT_STEREO16,		AL_FORMAT_STEREO_FLOAT32 },		// 2
+		{ 0,					0,						0 },							// 3
+		{ AL_FORMAT_QUAD8,		AL_FORMAT_QUAD16,		AL_FORMAT_QUAD32 },				// 4
+		{ 0,					0,						0 },							// 5
+		{ AL_FORMAT_51CHN8,		AL_FORMAT_51CHN16,		AL_FORMAT_51CHN32 },			// 6
+		{ AL_FORMAT_61CHN8,		AL_FORMAT_61CHN16,		AL_FORMAT_61CHN32 },			// 7
+		{ AL_FORMAT_71CHN8,		AL_FORMAT_71CHN16,		AL_FORMAT_71CHN32 },			// 8
+	};
+	if (_Channels < 1 || _Channels > 8)
+		return 0;
+	switch (_Fmt) {
+	case PCM_U8:	return s_Formats[_Channels-1][0];
+	case PCM_S16:	return s_Formats[_Channels-1][1];
+	case PCM_F32:	return s_Formats[_Channels-1][2];
+	}
+	return 0;
+}
+
+bool Pcm_Convert(int _Src, int _Dst, const void* _SrcData, void* _DstData, size_t _Count)
+{
+	const uint8_t* s = (const uint8_t*)_SrcData;
+	uint8_t* d = (uint8_t*)_DstData;
+	if (_Src == _Dst) {
+		memcpy(d, s, _Count * Pcm_Bytes(_Src));
+		return _Src != PCM_UNKNOWN;
+	}
+	switch (_Dst) {
+	case PCM_S16:	return Pcm_ConvertTo<PCM_S16>(_Src, s, d, _Count);
+	case PCM_F32:	return Pcm_ConvertTo<PCM_F32>(_Src, s, d, _Count);
+	}
+	return false;
+}
+
+size_t Pcm_Ima4Bytes(size_t _Frames, int _Channels, int _SamplesPerBlock)
+{
+	size_t blocks = (_Frames + _SamplesPerBlock-1) / _SamplesPerBlock;
+	return blocks * _Channels * (4 + (_SamplesPerBlock-1)/2);
+}
+
+// each block: a 4 bytes header per channel (first sample, step index), then
+// the channels interleaved by groups of 8 samples, low nibble first.
+bool Pcm_EncodeIma4(const int16_t* _Src, void* _Dst, size_t _Frames, int _Channels, int _SamplesPerBlock)
+{
+	if (_Channels < 1 || _Channels > 8 || _SamplesPerBlock < 9 || (_SamplesPerBlock-1) % 8 != 0)
+		return false;
+
+	SImaState State[8];
+	memset(State, 0, sizeof(State));
+
+	uint8_t* d = (uint8_t*)_Dst;
+	for (size_t f0 = 0; f0 < _Frames; f0 += _SamplesPerBlock) {
+		for (int c = 0; c < _Channels; c++) {
+			SImaState& S = State[c];
+			S.predictor = Ima_Sample(_Src, _Frames, _Channels, f0, c);
+
+			uint8_t* h = d + c*4;
+			h[0] = (uint8_t)(S.predictor & 0xFF);
+			h[1] = (uint8_t)((S.predictor >> 8) & 0xFF);
+			h[2] = (uint8_t)S.index;
+			h[3] = 0;
+
+			uint8_t* out = d + _Channels*4 + c*4;
+			for (int i = 1; i < _SamplesPerBlock; i += 8) {
+				for (int k = 0; k < 8; k += 2) {
+					uint8_t lo = Ima_Encode(S, Ima_Sample(_Src, _Frames, _Channels, f0+i+k, c));
+					uint8_t hi = Ima_Encode(S, Ima_Sample(_Src, _Frames, _Channels, f0+i+k+1, c));
+					out[k/2] = lo | (hi << 4);
+				}
+				out += 4*_Channels;
+			}
+		}
+		d += _Channels * (4 + (_SamplesPerBlock-1)/2);
+	}
+	return true;
+}
@@ -0,0 +1,44 @@
+// PCM sample formats and conversion to what OpenAL accepts.
+// Kernels are specialized at compile time per source/destination format,
+// with SSE2 and AVX2 paths picked at runtime and a scalar fallback.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <AL/al.h>
+
+enum EPcmFormat {
+	PCM_UNKNOWN = -1,
+	PCM_U8,
+	PCM_S16,
+	PCM_S16BE,
+	PCM_S24,			// packed, 3 bytes
+	PCM_S24BE,
+	PCM_S32,
+	PCM_S32BE,
+	PCM_F32,
+	PCM_F32BE,
+	PCM_F64,
+	PCM_F64BE,
+};
+
+int			Pcm_Bytes(int _Fmt);
+const char*	Pcm_Name(int _Fmt);
+
+// format a source is converted to for OpenAL: U8, S16 or F32.
+int			Pcm_TargetFormat(int _Src);
+
+// AL format for _Fmt (U8, S16 or F32) and 1, 2, 4, 6, 7 or 8 channels, 0 if none.
+// more than two channels needs AL_EXT_MCFORMATS.
+ALenum		Pcm_ALFormat(int _Fmt, int _Channels);
+
+// _Dst is PCM_S16 or PCM_F32 (or _Src itself: plain copy), _Count in samples.
+bool		Pcm_Convert(int _Src, int _Dst, const void* _SrcData, void* _DstData, size_t _Count);
+
+// IMA ADPCM in the wav block layout (AL_EXT_IMA4 + AL_SOFT_block_alignment), 4 bits per sample.
+// interleaved S16 frames are padded with silence up to whole blocks, (_SamplesPerBlock-1) must be a multiple of 8.
+#define PCM_IMA4_BLOCK_FRAMES	1017		// 512 bytes blocks per channel
+size_t		Pcm_Ima4Bytes(size_t _Frames, int _Channels, int _SamplesPerBlock=PCM_IMA4_BLOCK_FRAMES);
+bool		Pcm_EncodeIma4(const int16_t* _Src, void* _Dst, size_t _Frames, int _Channels, int _SamplesPerBlock=PCM_IMA4_BLOCK_FRAMES);
@@ -0,0 +1,213 @@
+// polyphase resampler
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "resample.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define RESAMPLE_X86 1
+#include <immintrin.h>
+#define RESAMPLE_AVX2 __attribute__((target("avx2")))
+#else
+#define RESAMPLE_X86 0
+#endif
+
+#define RESAMPLE_TAPS		32			// per phase when upsampling, more when downsampling
+#define RESAMPLE_MAX_TAPS	256
+#define RESAMPLE_ROLLOFF	0.91f		// cutoff, relative to the lower nyquist
+#define RESAMPLE_BETA		8.0			// kaiser window
+
+// L/M: output samples are the input upsampled by L then decimated by M.
+// phase p of output n = (n*M) % L, its taps start at input (n*M) / L - (taps/2-1).
+struct SResampleFilter {
+	int		L, M;
+	int		taps;			// multiple of 8
+	float*	coefs;			// [L][taps]
+};
+
+static int Gcd(int a, int b)
+{
+	while (b != 0) { int t = a % b; a = b; b = t; }
+	return a;
+}
+
+// modified bessel function of the first kind, order 0.
+static double BesselI0(double x)
+{
+	double sum = 1, term = 1;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2*k)) * (x / (2*k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static bool Resample_Ratio(int _SrcFreq, int _DstFreq, int& L, int& M)
+{
+	if (_SrcFreq <= 0 || _DstFreq <= 0)
+		return false;
+	int g = Gcd(_SrcFreq, _DstFreq);
+	L = _DstFreq / g;
+	M = _SrcFreq / g;
+	return L <= RESAMPLE_MAX_PHASES;
+}
+
+static bool Resample_Build(SResampleFilter& _F, int _SrcFreq, int _DstFreq)
+{
+	memset(&_F, 0, sizeof(_F));
+	if (!Resample_Ratio(_SrcFreq, _DstFreq, _F.L, _F.M))
+		return false;
+
+	// downsampling lowers the cutoff, the filter widens to keep the same transition band.
+	const double fc = (_F.L < _F.M ? (double)_F.L / _F.M : 1.) * RESAMPLE_ROLLOFF;
+	int taps = _F.L < _F.M ? (int)ceil(RESAMPLE_TAPS * (double)_F.M / _F.L) : RESAMPLE_TAPS;
+	taps = (taps + 7) & ~7;
+	_F.taps = taps < RESAMPLE_MAX_TAPS ? taps : RESAMPLE_MAX_TAPS;
+
+	_F.coefs = (float*)aligned_alloc(32, (size_t)_F.L * _F.taps * sizeof(float));
+	const int pre = _F.taps/2 - 1;
+	const double half = _F.taps / 2.;
+	const double i0beta = BesselI0(RESAMPLE_BETA);
+	for (int p = 0; p < _F.L; p++) {
+		float* h = _F.coefs + (size_t)p * _F.taps;
+		double sum = 0;
+		for (int k = 0; k < _F.taps; k++) {
+			double d = (k - pre) - (double)p / _F.L;		// in input samples from the output point
+			double x = fc * d;
+			double sinc = fabs(x) < 1e-9 ? 1. : sin(M_PI * x) / (M_PI * x);
+			double r = d / half;
+			double w = fabs(r) < 1. ? BesselI0(RESAMPLE_BETA * sqrt(1. - r*r)) / i0beta : 0.;
+			h[k] = (float)(fc * sinc * w);
+			sum += h[k];
+		}
+		// unity gain at dc for every phase.
+		for (int k = 0; k < _F.taps; k++)
+			h[k] = (float)(h[k] / sum);
+	}
+	return true;
+}
+
+// ------------------- dot products -------------------------
+// _Count is a multiple of 8, _Coefs 32 bytes aligned.
+
+#if RESAMPLE_X86
+static float Dot_SSE2(const float* _X, const float* _Coefs, int _Count)
+{
+	__m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+	for (int i = 0; i < _Count; i += 8) {
+		a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(_X+i), _mm_load_ps(_Coefs+i)));
+		a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(_X+i+4), _mm_load_ps(_Coefs+i+4)));
+	}
+	__m128 s = _mm_add_ps(a0, a1);
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+RESAMPLE_AVX2 static float Dot_AVX2(const float* _X, const float* _Coefs, int _Count)
+{
+	__m256 a = _mm256_setzero_ps();
+	for (int i = 0; i < _Count; i += 8)
+		a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(_X+i), _mm256_load_ps(_Coefs+i)));
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#else
+static float Dot_Scalar(const float* _X, const float* _Coefs, int _Count)
+{
+	float sum = 0;
+	for (int i = 0; i < _Count; i++)
+		sum += _X[i] * _Coefs[i];
+	return sum;
+}
+#endif
+
+typedef float (*FDot)(const float*, const float*, int);
+
+static FDot Resample_Dot()
+{
+#if RESAMPLE_X86
+	static const bool s_AVX2 = __builtin_cpu_supports("avx2");
+	return s_AVX2 ? Dot_AVX2 : Dot_SSE2;
+#else
+	return Dot_Scalar;
+#endif
+}
+
+
+// outputs [_From, _To), _Num/_Den input frames apart from output 0 at _X[pre], every _Stride floats of _Dst.
+// M/L is the exact grid, other steps take the nearest of the L phases.
+static void Resample_Run(const SResampleFilter& _F, FDot _Dot, const float* _X, float* _Dst, size_t _From, size_t _To, int _Stride, size_t _Num, size_t _Den)
+{
+	for (size_t n = _From; n < _To; n++) {
+		size_t base = n * _Num / _Den;
+		size_t p = (n * _Num % _Den * _F.L + _Den/2) / _Den;
+		if (p == (size_t)_F.L) { p = 0; base++; }
+		_Dst[n*_Stride] = _Dot(_X + base, _F.coefs + p * _F.taps, _F.taps);
+	}
+}
+
+
+// ------------------- public -------------------------
+size_t Resample_Frames(size_t _Frames, int _SrcFreq, int _DstFreq)
+{
+	int L, M;
+	if (!Resample_Ratio(_SrcFreq, _DstFreq, L, M))
+		return 0;
+	return (_Frames * L + M-1) / M;
+}
+
+bool Resample_F32(const float* _Src, float* _Dst, size_t _Frames, int _Channels, int _SrcFreq, int _DstFreq, size_t& _LoopStart, size_t& _LoopEnd)
+{
+	if (_Frames == 0)
+		return false;
+	SResampleFilter F;
+	if (!Resample_Build(F, _SrcFreq, _DstFreq))
+		return false;
+
+	const FDot Dot = Resample_Dot();
+	const size_t out = (_Frames * F.L + F.M-1) / F.M;
+	const int pre = F.taps/2 - 1;
+
+	// the loop gets [start, end) of the output, from its first frame and stretched by less than
+	// half a frame to fill it exactly. (start rounded down and the length to the nearest: end never passes out)
+	const bool loop = _LoopEnd > _LoopStart && _LoopEnd <= _Frames;
+	const size_t cLoop = loop ? _LoopEnd - _LoopStart : 0;
+	const size_t start = _LoopStart * F.L / F.M;
+	size_t end = loop ? start + (cLoop * 2 * F.L + F.M) / (2 * F.M) : _LoopEnd * F.L / F.M;
+	if (loop && end == start)
+		end++;
+
+	// one channel at a time, deinterleaved with the filter margins on both sides, then the loop wrapped.
+	const size_t len = _Frames + F.taps;
+	float* x = (float*)malloc((len + (loop ? cLoop + F.taps : 0)) * sizeof(float));
+	float* xl = x + len;
+	for (int c = 0; c < _Channels; c++) {
+		for (size_t i = 0; i < len; i++) {
+			ptrdiff_t s = (ptrdiff_t)i - pre;
+			x[i] = s >= 0 && s < (ptrdiff_t)_Frames ? _Src[s*_Channels + c] : 0;
+		}
+		if (!loop) {
+			Resample_Run(F, Dot, x, _Dst + c, 0, out, _Channels, F.M, F.L);
+			continue;
+		}
+		for (size_t i = 0; i < cLoop + F.taps; i++) {
+			ptrdiff_t s = ((ptrdiff_t)i - pre) % (ptrdiff_t)cLoop;
+			xl[i] = _Src[(_LoopStart + (s < 0 ? s + cLoop : s))*_Channels + c];
+		}
+		Resample_Run(F, Dot, x, _Dst + c, 0, start, _Channels, F.M, F.L);
+		Resample_Run(F, Dot, xl, _Dst + start*_Channels + c, 0, end - start, _Channels, cLoop, end - start);
+		Resample_Run(F, Dot, x, _Dst + c, end, out, _Channels, F.M, F.L);
+	}
+	free(x);
+	free(F.coefs);
+	_LoopStart = start;
+	_LoopEnd = end;
+	return true;
+}
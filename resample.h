@@ -0,0 +1,17 @@
+// Polyphase windowed sinc resampling of whole sounds, done once at load time:
+// buffers at the device rate then mix without per voice resampling.
+
+#pragma once
+
+#include <stddef.h>
+
+#define RESAMPLE_MAX_PHASES	1024		// rate ratios reducing to more phases are left to OpenAL
+
+// frames produced from _Frames at _SrcFreq, 0 if the ratio is not supported.
+size_t		Resample_Frames(size_t _Frames, int _SrcFreq, int _DstFreq);
+
+// interleaved F32, _Dst holds Resample_Frames() frames.
+// _LoopStart, _LoopEnd: the loop in _Src frames (_LoopEnd 0: none), returned in _Dst frames. the loop is
+// resampled on its own, the filter reading across its end instead of the frames around it, and its
+// length rounded once: it repeats seamlessly, sample-exact.
+bool		Resample_F32(const float* _Src, float* _Dst, size_t _Frames, int _Channels, int _SrcFreq, int _DstFreq, size_t& _LoopStart, size_t& _LoopEnd);
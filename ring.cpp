@@ -0,0 +1,61 @@
+// spsc ring
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "ring.h"
+
+bool Ring_Init(SRing& _Ring, int _Size, int _Capacity)
+{
+	memset(&_Ring, 0, sizeof(_Ring));
+	if (_Capacity <= 0 || (_Capacity & (_Capacity-1)) != 0) {
+		ERR("Ring_Init: Capacity %d is not a power of 2\n", _Capacity);
+		return false;
+	}
+	_Ring.capacity = _Capacity;
+	_Ring.size = _Size;
+	_Ring.data = (Uint8*)calloc(_Capacity, _Size);
+	return _Ring.data != NULL;
+}
+
+void Ring_Free(SRing& _Ring)
+{
+	free(_Ring.data);
+	memset(&_Ring, 0, sizeof(_Ring));
+}
+
+// indices run freely and wrap, only their difference matters.
+bool Ring_Push(SRing& _Ring, const void* _Elem)
+{
+	const Uint32 head = SDL_AtomicGet(&_Ring.head);
+	const Uint32 tail = SDL_AtomicGet(&_Ring.tail);
+	if (head - tail >= (Uint32)_Ring.capacity)
+		return false;
+	memcpy(_Ring.data + (head & (_Ring.capacity-1)) * _Ring.size, _Elem, _Ring.size);
+
+	// publish the element before the index.
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&_Ring.head, (int)(head + 1));
+	return true;
+}
+
+bool Ring_Pop(SRing& _Ring, void* _Elem)
+{
+	const Uint32 tail = SDL_AtomicGet(&_Ring.tail);
+	const Uint32 head = SDL_AtomicGet(&_Ring.head);
+	if (head == tail)
+		return false;
+	SDL_MemoryBarrierAcquire();
+	memcpy(_Elem, _Ring.data + (tail & (_Ring.capacity-1)) * _Ring.size, _Ring.size);
+
+	// the slot is read before the producer gets it back.
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&_Ring.tail, (int)(tail + 1));
+	return true;
+}
+
+int Ring_Count(SRing& _Ring)
+{
+	return (int)((Uint32)SDL_AtomicGet(&_Ring.head) - (Uint32)SDL_AtomicGet(&_Ring.tail));
+}
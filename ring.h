@@ -0,0 +1,21 @@
+// Single producer single consumer ring of fixed size elements: pushes and pops
+// never block nor allocate, so either side may be an audio or driver thread.
+
+#pragma once
+
+#include <SDL.h>
+
+struct SRing {
+	SDL_atomic_t	head;		// pushed, written by the producer only
+	SDL_atomic_t	tail;		// popped, written by the consumer only
+	int				capacity;	// power of 2
+	int				size;		// of an element
+	Uint8*			data;
+};
+
+bool	Ring_Init(SRing& _Ring, int _Size, int _Capacity);
+void	Ring_Free(SRing& _Ring);
+
+bool	Ring_Push(SRing& _Ring, const void* _Elem);		// false when full
+bool	Ring_Pop(SRing& _Ring, void* _Elem);			// false when empty
+int		Ring_Count(SRing& _Ring);
@@ -0,0 +1,593 @@
+// sound assets loading
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <SDL.h>
+
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <AL/alext.h>
+
+#include "common.h"
+#include "pcm.h"
+#include "resample.h"
+#include "wav.h"
+#include "soundpack.h"
+#include "cache.h"
+#include "sound.h"
+
+#define LOADER_MAX_THREADS	8
+#define LOADER_MAX_JOBS		256
+#define LOADER_MAX_RETIRED	64
+
+static SPack		s_Pack;
+static char			s_PackRoot[256];
+
+// -------------------  LoadSound -------------------------
+// with its loop points. converted data also goes to the decoded cache under _Key (0: not cached).
+// the AL error state is the context's, shared with the other loaders and the audio thread:
+// the result is read back from the buffer instead.
+static ALuint Sound_Upload(const SCacheData& _D, uint64_t _Key, const char* name)
+{
+	ALuint buffer = 0;
+	alGenBuffers(1, &buffer);
+	if (buffer == 0 || !alIsBuffer(buffer)) {
+		ERR("LoadSound(%s): alGenBuffers failed\n", name);
+		return 0;
+	}
+	if (_D.align > 0)
+		alBufferi(buffer, AL_UNPACK_BLOCK_ALIGNMENT_SOFT, _D.align);
+	alBufferData(buffer, _D.format, _D.data, _D.bytes, _D.freq);
+	ALint size = 0;
+	alGetBufferi(buffer, AL_SIZE, &size);
+	if (size <= 0) {
+		ERR("LoadSound(%s): alBufferData failed: format=0x%X %u bytes\n", name, _D.format, _D.bytes);
+		alDeleteBuffers(1, &buffer);
+		return 0;
+	}
+	if (_D.loop_end > 0) {
+		ALint points[2] = { (ALint)_D.loop_start, (ALint)_D.loop_end };
+		ALint set[2] = { 0, 0 };
+		alBufferiv(buffer, AL_LOOP_POINTS_SOFT, points);
+		alGetBufferiv(buffer, AL_LOOP_POINTS_SOFT, set);
+		if (set[0] != points[0] || set[1] != points[1])
+			ERR("LoadSound(%s): Loop points %d-%d refused, loops the whole buffer\n", name, points[0], points[1]);
+	}
+
+	if (_Key != 0)
+		Cache_Store(_Key, _D);
+	return buffer;
+}
+
+// AL format of a wav ADPCM tag, 0 if the device can't decode it.
+static ALenum Sound_AdpcmFormat(int _Tag, int _Channels)
+{
+	if (_Channels < 1 || _Channels > 2 || !alIsExtensionPresent("AL_SOFT_block_alignment"))
+		return 0;
+	if (_Tag == WAV_FORMAT_IMA_ADPCM && alIsExtensionPresent("AL_EXT_IMA4"))
+		return _Channels == 1 ? AL_FORMAT_MONO_IMA4 : AL_FORMAT_STEREO_IMA4;
+	if (_Tag == WAV_FORMAT_ADPCM && alIsExtensionPresent("AL_SOFT_MSADPCM"))
+		return _Channels == 1 ? AL_FORMAT_MONO_MSADPCM_SOFT : AL_FORMAT_STEREO_MSADPCM_SOFT;
+	return 0;
+}
+
+static SCacheData Sound_Data(ALenum _Format, const void* _Data, Uint32 _Bytes, int _Freq, int _Align=0)
+{
+	SCacheData D;
+	memset(&D, 0, sizeof(D));
+	D.format = _Format;
+	D.data = _Data;
+	D.bytes = _Bytes;
+	D.freq = _Freq;
+	D.align = _Align;
+	return D;
+}
+
+// smpl loop points in frames, _LoopEnd == 0: none. an intro then plays once before the loop.
+// without loop points, loops still skip the silence padding the last ADPCM block (_Length > _Frames).
+static void Sound_LoopPoints(SCacheData& _D, Uint32 _LoopStart, Uint32 _LoopEnd, Uint32 _Frames, Uint32 _Length)
+{
+	if (_LoopEnd == 0) {
+		_LoopStart = 0;
+		_LoopEnd = _Frames;
+	}
+	if (_LoopStart == 0 && _LoopEnd >= _Length)
+		return;
+	if (!alIsExtensionPresent("AL_SOFT_loop_points")) {
+		ERR("Sound_LoopPoints: No AL_SOFT_loop_points, loops the whole buffer\n");
+		return;
+	}
+	_D.loop_start = _LoopStart;
+	_D.loop_end = _LoopEnd;
+}
+
+// interleaved S16 frames, encoded to IMA4 for the AL buffer.
+static ALuint Sound_UploadIma4(ALenum _Format, const int16_t* _Data, Uint32 _Frames, int _Channels, int _Freq, Uint32 _LoopStart, Uint32 _LoopEnd, uint64_t _Key, const char* name)
+{
+	size_t bytes = Pcm_Ima4Bytes(_Frames, _Channels);
+	void* encoded = malloc(bytes);
+	Pcm_EncodeIma4(_Data, encoded, _Frames, _Channels);
+
+	SCacheData D = Sound_Data(_Format, encoded, bytes, _Freq, PCM_IMA4_BLOCK_FRAMES);
+	Sound_LoopPoints(D, _LoopStart, _LoopEnd, _Frames, (_Frames + PCM_IMA4_BLOCK_FRAMES-1) / PCM_IMA4_BLOCK_FRAMES * PCM_IMA4_BLOCK_FRAMES);
+	ALuint buffer = Sound_Upload(D, _Key, name);
+	free(encoded);
+	return buffer;
+}
+
+// _Fmt (U8, S16 or F32) frames, resampled to the mix rate and/or IMA4 encoded as _Flags ask.
+// a loop is resampled across its edges.
+static ALuint Sound_UploadPcm(int _Fmt, const void* _Data, Uint32 _Frames, int _Channels, int _Freq, int _Flags, Uint32 _LoopStart, Uint32 _LoopEnd, uint64_t _Key, const char* name)
+{
+	// once here, instead of on every mix.
+	void* resampled = NULL;
+	const int mix = (_Flags & SOUND_RESAMPLE) ? Sound_DeviceFreq() : 0;
+	const size_t out = (mix > 0 && mix != _Freq) ? Resample_Frames(_Frames, _Freq, mix) : 0;
+	if (out > 0) {
+		const size_t count = (size_t)_Frames * _Channels;
+		float* in = (float*)_Data;
+		if (_Fmt != PCM_F32) {
+			in = (float*)malloc(count * sizeof(float));
+			Pcm_Convert(_Fmt, PCM_F32, _Data, in, count);
+		}
+		resampled = malloc(out * _Channels * sizeof(float));
+		size_t loop_start = _LoopStart, loop_end = _LoopEnd;
+		bool ok = Resample_F32(in, (float*)resampled, _Frames, _Channels, _Freq, mix, loop_start, loop_end);
+		if (in != _Data)
+			free(in);
+		if (ok) {
+			_LoopStart = (Uint32)loop_start;
+			_LoopEnd = (Uint32)loop_end;
+			_Fmt = PCM_F32;
+			_Data = resampled;
+			_Frames = out;
+			_Freq = mix;
+		}
+	}
+
+	ALenum ima4 = (_Flags & SOUND_ADPCM) ? Sound_AdpcmFormat(WAV_FORMAT_IMA_ADPCM, _Channels) : 0;
+	int dst = ima4 != 0 ? PCM_S16 : _Fmt;		// (the encoder input)
+	ALenum format = ima4 != 0 ? ima4 : Sound_ALFormat(dst, _Channels);
+
+	ALuint buffer = 0;
+	if (format != 0) {
+		const size_t count = (size_t)_Frames * _Channels;
+		const void* data = _Data;
+		void* converted = NULL;
+		if (dst != _Fmt) {
+			converted = malloc(count * Pcm_Bytes(dst));
+			Pcm_Convert(_Fmt, dst, _Data, converted, count);
+			data = converted;
+		}
+		if (ima4 != 0) {
+			buffer = Sound_UploadIma4(ima4, (const int16_t*)data, _Frames, _Channels, _Freq, _LoopStart, _LoopEnd, _Key, name);
+		} else {
+			SCacheData D = Sound_Data(format, data, count * Pcm_Bytes(dst), _Freq);
+			Sound_LoopPoints(D, _LoopStart, _LoopEnd, _Frames, _Frames);
+			buffer = Sound_Upload(D, _Key, name);
+		}
+		free(converted);
+	}
+	free(resampled);
+	return buffer;
+}
+
+// PCM format of a pack entry AL format.
+static int Sound_PcmFormat(ALenum _Format, int _Channels)
+{
+	static const int s_Fmts[] = { PCM_U8, PCM_S16, PCM_F32 };
+	for (int i = 0; i < 3; i++) {
+		if (Pcm_ALFormat(s_Fmts[i], _Channels) == _Format)
+			return s_Fmts[i];
+	}
+	return PCM_UNKNOWN;
+}
+
+// everything changing what a conversion outputs.
+static uint64_t Sound_CacheSettings(int _Flags)
+{
+	uint64_t s = CACHE_VERSION;
+	s = s*31 + (_Flags & (SOUND_RESAMPLE|SOUND_ADPCM));
+	s = s*31 + ((_Flags & SOUND_RESAMPLE) ? Sound_DeviceFreq() : 0);
+	s = s*31 + alIsExtensionPresent("AL_EXT_FLOAT32");
+	s = s*31 + alIsExtensionPresent("AL_SOFT_loop_points");
+	s = s*31 + (Sound_AdpcmFormat(WAV_FORMAT_IMA_ADPCM, 1) != 0);
+	return s;
+}
+
+// warm path: uploaded straight from the cache mapping.
+static ALuint Sound_LoadCached(uint64_t _Key, const char* name)
+{
+	SCacheFile F;
+	SCacheData D;
+	if (!Cache_Open(_Key, F, D))
+		return 0;
+	ALuint buffer = Sound_Upload(D, 0, name);
+	Cache_Close(F);
+	return buffer;
+}
+
+static ALuint LoadPackedSound(const SPackEntry& _Entry, const char* name, int _Flags, bool& _Cached)
+{
+	const void* data = Pack_Data(s_Pack, _Entry);
+	const int fmt = Sound_PcmFormat(_Entry.format, _Entry.channels);
+	const Uint32 frames = fmt != PCM_UNKNOWN ? _Entry.bytes / (Pcm_Bytes(fmt)*_Entry.channels) : 0;
+	ALuint buffer = 0;
+	if (fmt != PCM_UNKNOWN && (_Flags & (SOUND_ADPCM|SOUND_RESAMPLE))) {
+		uint64_t key = Cache_Enabled() ? Cache_Key(data, _Entry.bytes, Sound_CacheSettings(_Flags) ^ _Entry.loop_start ^ ((uint64_t)_Entry.loop_end << 32)) : 0;
+		if (key != 0 && !(_Flags & SOUND_NOCACHE))
+			buffer = Sound_LoadCached(key, name);
+		_Cached = buffer != 0;
+		if (buffer == 0)
+			buffer = Sound_UploadPcm(fmt, data, frames, _Entry.channels, _Entry.freq, _Flags, _Entry.loop_start, _Entry.loop_end, key, name);
+	} else {
+		SCacheData D = Sound_Data(_Entry.format, data, _Entry.bytes, _Entry.freq);
+		if (frames > 0)
+			Sound_LoopPoints(D, _Entry.loop_start, _Entry.loop_end, frames, frames);
+		buffer = Sound_Upload(D, 0, name);
+	}
+	Pack_Release(s_Pack, _Entry);
+	return buffer;
+}
+
+// the data chunk is uploaded straight from the file mapping, without intermediate copy.
+// sounds needing a conversion are looked up in the decoded cache first.
+ALuint LoadSound(const char* name, SLoadStats* stats, int _Flags)
+{
+	Uint64 t0 = SDL_GetPerformanceCounter();
+	bool cached = false;
+
+	// sounds under the pack root are resolved in the mounted pack first.
+	const size_t root_len = strlen(s_PackRoot);
+	if (s_Pack.map && !(_Flags & SOUND_NOPACK) && strncmp(name, s_PackRoot, root_len) == 0) {
+		if (const SPackEntry* E = Pack_Find(s_Pack, name + root_len)) {
+			ALuint buffer = LoadPackedSound(*E, name, _Flags, cached);
+			if (buffer != 0 && stats) {
+				stats->bytes += E->bytes;
+				stats->seconds += (double)(SDL_GetPerformanceCounter() - t0) / SDL_GetPerformanceFrequency();
+				stats->cached += cached;
+			}
+			return buffer;
+		}
+	}
+
+	SWavFile wav;
+	if (!Wav_Open(name, wav))
+		return 0;
+
+	ALuint buffer = 0;
+	const int src = Wav_PcmFormat(wav);
+	if (wav.tag == WAV_FORMAT_IMA_ADPCM || wav.tag == WAV_FORMAT_ADPCM) {
+		// already compressed: OpenAL decodes the blocks while mixing.
+		ALenum format = Sound_AdpcmFormat(wav.tag, wav.channels);
+		if (format == 0 || wav.block_align == 0 || wav.samples_per_block == 0) {
+			ERR("LoadSound(%s): Unsupported ADPCM: tag=0x%X channels=%d\n", name, wav.tag, wav.channels);
+			Wav_Close(wav);
+			return 0;
+		}
+		SCacheData D = Sound_Data(format, wav.data, wav.data_bytes, wav.freq, wav.samples_per_block);
+		Sound_LoopPoints(D, wav.loop_start, wav.loop_end, wav.frames, wav.data_bytes / wav.block_align * wav.samples_per_block);
+		buffer = Sound_Upload(D, 0, name);
+	} else {
+		int dst = Pcm_TargetFormat(src);
+		ALenum format = Sound_ALFormat(dst, wav.channels);
+		if (format == 0) {
+			ERR("LoadSound(%s): Unsupported format: tag=0x%X %s channels=%d\n", name, wav.tag, Pcm_Name(src), wav.channels);
+			Wav_Close(wav);
+			return 0;
+		}
+
+		// the key covers the whole file: format, loop points and data.
+		const bool convert = src != dst || (_Flags & (SOUND_ADPCM|SOUND_RESAMPLE));
+		const uint64_t key = convert && Cache_Enabled() ? Cache_Key(wav.map, wav.map_size, Sound_CacheSettings(_Flags)) : 0;
+		if (key != 0 && !(_Flags & SOUND_NOCACHE))
+			buffer = Sound_LoadCached(key, name);
+		cached = buffer != 0;
+
+		// uploaded from the mapping as is when possible.
+		if (buffer == 0) {
+			const void* data = wav.data;
+			Uint32 data_bytes = wav.data_bytes;
+			void* converted = NULL;
+			if (src != dst) {
+				size_t count = wav.data_bytes / Pcm_Bytes(src);
+				data_bytes = count * Pcm_Bytes(dst);
+				converted = malloc(data_bytes);
+				Pcm_Convert(src, dst, wav.data, converted, count);
+				data = converted;
+			}
+
+			if (_Flags & (SOUND_ADPCM|SOUND_RESAMPLE)) {
+				buffer = Sound_UploadPcm(dst, data, wav.frames, wav.channels, wav.freq, _Flags, wav.loop_start, wav.loop_end, key, name);
+			} else {
+				SCacheData D = Sound_Data(format, data, data_bytes, wav.freq);
+				Sound_LoopPoints(D, wav.loop_start, wav.loop_end, wav.frames, wav.frames);
+				buffer = Sound_Upload(D, key, name);
+			}
+			free(converted);
+		}
+	}
+	Uint32 bytes = wav.data_bytes;
+	Wav_Close(wav);
+	if (buffer == 0)
+		return 0;
+
+	double seconds = (double)(SDL_GetPerformanceCounter() - t0) / SDL_GetPerformanceFrequency();
+	if (stats) {
+		stats->bytes += bytes;
+		stats->seconds += seconds;
+		stats->cached += cached;
+	}
+	return buffer;
+}
+
+int Sound_DeviceFreq()
+{
+	ALCint freq = 0;
+	if (ALCcontext* ctx = alcGetCurrentContext())
+		alcGetIntegerv(alcGetContextsDevice(ctx), ALC_FREQUENCY, 1, &freq);
+	return freq;
+}
+
+ALenum Sound_ALFormat(int& _Fmt, int _Channels)
+{
+	if (_Fmt == PCM_F32 && !alIsExtensionPresent("AL_EXT_FLOAT32"))
+		_Fmt = PCM_S16;
+	if (_Channels > 2 && !alIsExtensionPresent("AL_EXT_MCFORMATS"))
+		return 0;
+	return Pcm_ALFormat(_Fmt, _Channels);
+}
+
+void FreeSound(ALuint _Buf)
+{
+	if(alIsBuffer(_Buf))
+		alDeleteBuffers(1, &_Buf);
+}
+
+
+bool Sound_MountPack(const char* _Path, const char* _Root)
+{
+	Sound_UnmountPack();
+	if (!Pack_Open(_Path, s_Pack))
+		return false;
+	strncpy(s_PackRoot, _Root, sizeof(s_PackRoot)-1);
+	return true;
+}
+
+void Sound_UnmountPack()
+{
+	Pack_Close(s_Pack);
+	s_PackRoot[0] = 0;
+}
+
+int Sound_PackedCount()
+{
+	return s_Pack.header ? (int)s_Pack.header->cEntries : -1;
+}
+
+
+// -------------------  loader threads -------------------------
+struct SLoaderJob {
+	SSound*			sound;
+	bool			reload;
+};
+
+struct SLoaderState {
+	SDL_Thread*		Threads[LOADER_MAX_THREADS];	int cThreads;
+	SDL_mutex*		Lock;
+	SDL_sem*		Pending;
+	SDL_atomic_t	Quit;
+
+	SLoaderJob		Jobs[LOADER_MAX_JOBS];			// ring
+	int				Head;
+	int				cJobs;
+
+	ALuint			Retired[LOADER_MAX_RETIRED];	int cRetired;		// swapped out, main thread
+};
+static SLoaderState s_Loader;
+
+static void Loader_Reloaded(SSound* S)
+{
+	S->reloaded = LoadSound(S->path, NULL, S->flags);
+
+	// publish the buffer before the state, a failed reload keeps the current buffer.
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&S->reload, S->reloaded != 0 ? SOUND_READY : SOUND_EMPTY);
+}
+
+static bool Loader_Push(SSound& _Sound, bool _Reload)
+{
+	SDL_LockMutex(s_Loader.Lock);
+	if (s_Loader.cJobs == LOADER_MAX_JOBS) {
+		SDL_UnlockMutex(s_Loader.Lock);
+		ERR("Loader_Load(%s): Too many pending loads\n", _Sound.path);
+		return false;
+	}
+	SDL_AtomicSet(_Reload ? &_Sound.reload : &_Sound.state, SOUND_QUEUED);
+	SLoaderJob& J = s_Loader.Jobs[(s_Loader.Head + s_Loader.cJobs) % LOADER_MAX_JOBS];
+	J.sound = &_Sound;
+	J.reload = _Reload;
+	s_Loader.cJobs++;
+	SDL_UnlockMutex(s_Loader.Lock);
+
+	SDL_SemPost(s_Loader.Pending);
+	return true;
+}
+
+static int Loader_Thread(void*)
+{
+	for (;;) {
+		SDL_SemWait(s_Loader.Pending);
+		if (SDL_AtomicGet(&s_Loader.Quit))
+			break;
+
+		SDL_LockMutex(s_Loader.Lock);
+		SLoaderJob J = s_Loader.Jobs[s_Loader.Head];
+		s_Loader.Head = (s_Loader.Head + 1) % LOADER_MAX_JOBS;
+		s_Loader.cJobs--;
+		SDL_UnlockMutex(s_Loader.Lock);
+
+		SSound* S = J.sound;
+		if (J.reload) {
+			SDL_AtomicSet(&S->reload, SOUND_LOADING);
+			Loader_Reloaded(S);
+			continue;
+		}
+
+		SDL_AtomicSet(&S->state, SOUND_LOADING);
+		memset(&S->load, 0, sizeof(S->load));
+		S->buffer = LoadSound(S->path, &S->load, S->flags);
+
+		// publish the buffer before the state.
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&S->state, S->buffer != 0 ? SOUND_READY : SOUND_FAILED);
+	}
+	return 0;
+}
+
+bool Loader_Init(int _cThreads)
+{
+	memset(&s_Loader, 0, sizeof(s_Loader));
+
+	if (_cThreads <= 0)
+		_cThreads = SDL_GetCPUCount();
+	if (_cThreads > LOADER_MAX_THREADS)
+		_cThreads = LOADER_MAX_THREADS;
+
+	s_Loader.Lock = SDL_CreateMutex();
+	s_Loader.Pending = SDL_CreateSemaphore(0);
+	for (int i = 0; i < _cThreads; i++) {
+		SDL_Thread* t = SDL_CreateThread(Loader_Thread, "loader", NULL);
+		if (t == NULL) {
+			ERR("Loader_Init: SDL_CreateThread failed: %s\n", SDL_GetError());
+			break;
+		}
+		s_Loader.Threads[s_Loader.cThreads] = t;	s_Loader.cThreads++;
+	}
+
+	if (s_Loader.cThreads == 0) {
+		Loader_Shutdown();
+		return false;
+	}
+	return true;
+}
+
+void Loader_Shutdown()
+{
+	// queued jobs are dropped, their sounds stay SOUND_QUEUED.
+	SDL_AtomicSet(&s_Loader.Quit, 1);
+	for (int i = 0; i < s_Loader.cThreads; i++)
+		SDL_SemPost(s_Loader.Pending);
+	for (int i = 0; i < s_Loader.cThreads; i++)
+		SDL_WaitThread(s_Loader.Threads[i], NULL);
+	s_Loader.cThreads = 0;
+
+	// (sources stopped)
+	for (int i = 0; i < s_Loader.cRetired; i++)
+		FreeSound(s_Loader.Retired[i]);
+	s_Loader.cRetired = 0;
+
+	SDL_DestroySemaphore(s_Loader.Pending);	s_Loader.Pending = NULL;
+	SDL_DestroyMutex(s_Loader.Lock);		s_Loader.Lock = NULL;
+}
+
+void Loader_Load(SSound& _Sound, const char* _Path, int _Flags)
+{
+	strncpy(_Sound.path, _Path, sizeof(_Sound.path)-1);
+	_Sound.path[sizeof(_Sound.path)-1] = 0;
+	_Sound.flags = _Flags;
+	_Sound.buffer = 0;
+
+	if (!Loader_Push(_Sound, false))
+		SDL_AtomicSet(&_Sound.state, SOUND_FAILED);
+}
+
+void Loader_Free(SSound& _Sound)
+{
+	// (the loader threads must be stopped, or the sound finished loading)
+	if (SDL_AtomicGet(&_Sound.state) == SOUND_READY)
+		FreeSound(_Sound.buffer);
+	if (SDL_AtomicGet(&_Sound.reload) == SOUND_READY)
+		FreeSound(_Sound.reloaded);
+	_Sound.buffer = 0;
+	_Sound.reloaded = 0;
+	SDL_AtomicSet(&_Sound.state, SOUND_EMPTY);
+	SDL_AtomicSet(&_Sound.reload, SOUND_EMPTY);
+}
+
+bool Loader_Reload(SSound& _Sound)
+{
+	if (Sound_State(_Sound) != SOUND_READY || Sound_Reloading(_Sound))
+		return false;
+	// the pack has the old data.
+	_Sound.flags |= SOUND_NOPACK;
+	return Loader_Push(_Sound, true);
+}
+
+bool Loader_Retire(ALuint _Buffer)
+{
+	if (s_Loader.cRetired == LOADER_MAX_RETIRED)
+		return false;
+	s_Loader.Retired[s_Loader.cRetired] = _Buffer;	s_Loader.cRetired++;
+	return true;
+}
+
+bool Loader_Swap(SSound& _Sound)
+{
+	if (SDL_AtomicGet(&_Sound.reload) != SOUND_READY)
+		return false;
+	SDL_MemoryBarrierAcquire();
+
+	// sources still playing the old buffer finish with it.
+	if (!Loader_Retire(_Sound.buffer)) {
+		ERR("Loader_Swap(%s): Too many retired buffers\n", _Sound.path);
+		FreeSound(_Sound.reloaded);
+	} else
+		_Sound.buffer = _Sound.reloaded;
+	_Sound.reloaded = 0;
+	SDL_AtomicSet(&_Sound.reload, SOUND_EMPTY);
+	return true;
+}
+
+void Loader_Collect(const ALuint* _InUse, int _cInUse)
+{
+	for (int i = 0; i < s_Loader.cRetired; i++) {
+		ALuint buf = s_Loader.Retired[i];
+		bool used = false;
+		for (int j = 0; j < _cInUse && !used; j++)
+			used = _InUse[j] == buf;
+		if (used)
+			continue;
+		// (a failed delete is tried again next time)
+		FreeSound(buf);
+		if (buf != 0 && alIsBuffer(buf))
+			continue;
+		s_Loader.Retired[i] = s_Loader.Retired[s_Loader.cRetired-1];	s_Loader.cRetired--;
+		i--;
+	}
+}
+
+bool Sound_Reloading(const SSound& _Sound)
+{
+	return SDL_AtomicGet(const_cast<SDL_atomic_t*>(&_Sound.reload)) != SOUND_EMPTY;
+}
+
+int Sound_State(const SSound& _Sound)
+{
+	int state = SDL_AtomicGet(const_cast<SDL_atomic_t*>(&_Sound.state));
+	SDL_MemoryBarrierAcquire();
+	return state;
+}
+
+const char* Sound_StateName(int _State)
+{
+	switch (_State) {
+	case SOUND_EMPTY:	return "empty";
+	case SOUND_QUEUED:	return "queued";
+	case SOUND_LOADING:	return "loading";
+	case SOUND_READY:	return "ready";
+	case SOUND_FAILED:	return "failed";
+	}
+	return "?";
+}
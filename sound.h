@@ -0,0 +1,67 @@
+// Sound assets: wav files loaded into AL buffers, either directly or
+// in parallel on a pool of loader threads.
+
+#pragma once
+
+#include <SDL.h>
+#include <AL/al.h>
+
+enum ESoundState {
+	SOUND_EMPTY,
+	SOUND_QUEUED,
+	SOUND_LOADING,
+	SOUND_READY,
+	SOUND_FAILED,
+};
+
+// load flags
+enum ESoundFlags {
+	SOUND_ADPCM		= 1<<0,		// mono/stereo stored IMA4 compressed in the AL buffer (~4x smaller), when the device supports it
+	SOUND_RESAMPLE	= 1<<1,		// resampled at load time to the device mix rate
+	SOUND_NOPACK	= 1<<2,		// read from the file even when packed (set by reloads)
+	SOUND_NOCACHE	= 1<<3,		// converted again even if in the decoded cache (still stored)
+};
+
+struct SLoadStats {
+	Uint64	bytes;
+	double	seconds;
+	int		cached;		// sounds uploaded from the decoded cache
+};
+
+struct SSound {
+	char			path[256];
+	int				flags;		// ESoundFlags
+	SDL_atomic_t	state;		// ESoundState, the fields below are valid once SOUND_READY
+	ALuint			buffer;
+	SLoadStats		load;
+
+	// hot reload: decoded aside while the current buffer keeps playing
+	SDL_atomic_t	reload;		// ESoundState, SOUND_READY: 'reloaded' waits for Loader_Swap
+	ALuint			reloaded;
+};
+
+ALuint		LoadSound(const char* _Path, SLoadStats* _Stats=NULL, int _Flags=0);
+ALenum		Sound_ALFormat(int& _Fmt, int _Channels);		// may lower _Fmt to what the device supports
+void		FreeSound(ALuint _Buf);
+int			Sound_DeviceFreq();		// ALC_FREQUENCY of the current context
+
+// sounds under _Root are then loaded from the pack when it has them.
+bool		Sound_MountPack(const char* _Path, const char* _Root);
+void		Sound_UnmountPack();
+int			Sound_PackedCount();		// -1: no pack mounted
+
+bool		Loader_Init(int _cThreads=0);		// 0: one per core
+void		Loader_Shutdown();
+void		Loader_Load(SSound& _Sound, const char* _Path, int _Flags=0);
+void		Loader_Free(SSound& _Sound);
+
+// decodes a ready sound again from its file, then Loader_Swap hands the new buffer to the next plays
+// (the thread updating the sources). replaced buffers are deleted by Loader_Collect once no source has them anymore.
+bool		Loader_Reload(SSound& _Sound);
+bool		Loader_Swap(SSound& _Sound);
+bool		Loader_Retire(ALuint _Buffer);		// false: the list is full
+void		Loader_Collect(const ALuint* _InUse, int _cInUse);
+bool		Sound_Reloading(const SSound& _Sound);
+
+int			Sound_State(const SSound& _Sound);
+const char*	Sound_StateName(int _State);
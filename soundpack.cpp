@@ -0,0 +1,104 @@
+// sound pack runtime
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "soundpack.h"
+
+bool Pack_Open(const char* _Path, SPack& _Pack)
+{
+	memset(&_Pack, 0, sizeof(_Pack));
+
+	int fd = open(_Path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SPackHeader)) {
+		ERR("Pack_Open(%s): cannot stat or truncated\n", _Path);
+		close(fd);
+		return false;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		ERR("Pack_Open(%s): mmap failed\n", _Path);
+		return false;
+	}
+
+	const SPackHeader* H = (const SPackHeader*)map;
+	size_t toc_end = sizeof(SPackHeader) + (size_t)H->cSlots * sizeof(SPackEntry);
+	if (H->magic != PACK_MAGIC || H->version != PACK_VERSION
+	||	H->cSlots == 0 || (H->cSlots & (H->cSlots-1)) != 0 || toc_end > (size_t)st.st_size) {
+		ERR("Pack_Open(%s): bad header\n", _Path);
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	const SPackEntry* slots = (const SPackEntry*)(H + 1);
+	for (uint32_t i = 0; i < H->cSlots; i++) {
+		const SPackEntry& E = slots[i];
+		if (E.hash == 0)
+			continue;
+		if (E.name < toc_end || E.name >= (uint64_t)st.st_size
+		||	memchr((const char*)map + E.name, 0, st.st_size - E.name) == NULL
+		||	E.offset + E.bytes > (uint64_t)st.st_size) {
+			ERR("Pack_Open(%s): entry %u out of bounds\n", _Path, i);
+			munmap(map, st.st_size);
+			return false;
+		}
+	}
+
+	_Pack.map = map;
+	_Pack.map_size = st.st_size;
+	_Pack.header = H;
+	_Pack.slots = slots;
+	return true;
+}
+
+void Pack_Close(SPack& _Pack)
+{
+	if (_Pack.map)
+		munmap(_Pack.map, _Pack.map_size);
+	memset(&_Pack, 0, sizeof(_Pack));
+}
+
+const SPackEntry* Pack_Find(const SPack& _Pack, const char* _Name)
+{
+	if (_Pack.header == NULL)
+		return NULL;
+
+	const uint32_t hash = HashName(_Name);
+	const uint32_t mask = _Pack.header->cSlots - 1;
+	uint32_t i = hash & mask;
+	for (uint32_t probe = 0; probe <= mask; probe++, i = (i+1) & mask) {
+		const SPackEntry& E = _Pack.slots[i];
+		if (E.hash == hash && strcmp(Pack_Name(_Pack, E), _Name) == 0)
+			return &E;
+		if (E.hash == 0)
+			break;
+	}
+	return NULL;
+}
+
+const char* Pack_Name(const SPack& _Pack, const SPackEntry& _Entry)
+{
+	return (const char*)_Pack.map + _Entry.name;
+}
+
+const void* Pack_Data(const SPack& _Pack, const SPackEntry& _Entry)
+{
+	return (const uint8_t*)_Pack.map + _Entry.offset;
+}
+
+void Pack_Release(const SPack& _Pack, const SPackEntry& _Entry)
+{
+	// entries are page aligned: once uploaded their pages can leave the working set.
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	size_t bytes = _Entry.bytes & ~(page-1);
+	if (bytes > 0 && (_Entry.offset & (page-1)) == 0)
+		madvise((uint8_t*)_Pack.map + _Entry.offset, bytes, MADV_DONTNEED);
+}
@@ -0,0 +1,50 @@
+// Sound pack: one page aligned archive of pre-decoded PCM, baked offline by
+// testbed-pack and opened at runtime with a single mmap.
+//
+// layout:	SPackHeader
+//			SPackEntry[cSlots]		open addressing table on the name hash
+//			names					nul terminated, hashes are checked against them
+//			data					each entry starts on a PACK_ALIGN boundary
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACK_MAGIC		0x4B415053		// "SPAK"
+#define PACK_VERSION	2
+#define PACK_ALIGN		4096
+
+struct SPackHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	cEntries;
+	uint32_t	cSlots;			// power of two
+};
+
+struct SPackEntry {
+	uint32_t	hash;			// HashName of the path relative to the packed directory, 0: empty slot
+	uint32_t	format;			// AL format of the data
+	uint32_t	freq;
+	uint32_t	channels;
+	uint64_t	offset;			// from the start of the file
+	uint32_t	bytes;
+	uint32_t	loop_start;		// sample frames, loop_end == 0: no loop points
+	uint32_t	loop_end;
+	uint32_t	name;			// offset of the path from the start of the file
+};
+
+struct SPack {
+	void*				map;
+	size_t				map_size;
+	const SPackHeader*	header;
+	const SPackEntry*	slots;
+};
+
+bool				Pack_Open(const char* _Path, SPack& _Pack);
+void				Pack_Close(SPack& _Pack);
+
+const SPackEntry*	Pack_Find(const SPack& _Pack, const char* _Name);
+const char*			Pack_Name(const SPack& _Pack, const SPackEntry& _Entry);
+const void*			Pack_Data(const SPack& _Pack, const SPackEntry& _Entry);
+void				Pack_Release(const SPack& _Pack, const SPackEntry& _Entry);
@@ -0,0 +1,286 @@
+// streaming playback through OpenAL buffer queues
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <SDL.h>
+
+#include <AL/al.h>
+#include <AL/alext.h>
+
+#include "common.h"
+#include "pcm.h"
+#include "wav.h"
+#include "sound.h"
+#include "stream.h"
+
+#define STREAM_MAX_STREAMS		16
+#define STREAM_NUM_BUFFERS		4
+#define STREAM_BUFFER_FRAMES	8192		// ~190ms at 44.1kHz
+#define STREAM_PERIOD_MS		10
+
+struct SStream {
+	char		path[256];
+	SDL_atomic_t reload;		// reopen the file at the next loop
+	SWavFile	wav;			// mapped, pages are dropped once uploaded
+	int			src_fmt;		// EPcmFormat
+	int			dst_fmt;
+	ALenum		format;
+	int			frame_bytes;	// uploaded
+	bool		loop;
+	Uint32		loop_start;		// bytes in the data chunk, the smpl loop or the whole data
+	Uint32		loop_end;
+	Uint32		read_pos;		// bytes consumed in the data chunk
+
+	ALuint		source;
+	ALuint		buffers[STREAM_NUM_BUFFERS];
+	ALuint		free[STREAM_NUM_BUFFERS];		int cFree;	// not queued on the source
+	Uint8*		scratch;
+};
+
+static SDL_Thread*	s_Thread = NULL;
+static SDL_mutex*	s_Lock = NULL;
+static SDL_atomic_t	s_Quit;
+static SStream*		s_Streams[STREAM_MAX_STREAMS];	static int s_cStreams = 0;
+
+
+// -------------------  stream thread -------------------------
+// an intro plays once, then the smpl loop repeats.
+static void Stream_SetLoop(SStream& _S)
+{
+	const SWavFile& W = _S.wav;
+	_S.loop_start = W.has_loop ? W.loop_start * W.block_align : 0;
+	_S.loop_end = W.has_loop ? W.loop_end * W.block_align : W.data_bytes;
+}
+
+static Uint32 Stream_End(const SStream& _S)
+{
+	return _S.loop ? _S.loop_end : _S.wav.data_bytes;
+}
+
+// back to the start of the loop, in the file reopened if it changed meanwhile.
+static void Stream_Wrap(SStream& _S)
+{
+	_S.read_pos = _S.loop_start;
+	if (SDL_AtomicSet(&_S.reload, 0) == 0)
+		return;
+
+	SWavFile wav;
+	if (!Wav_Open(_S.path, wav))
+		return;
+	// (the queued buffers and the scratch keep the format)
+	if (Wav_PcmFormat(wav) != _S.src_fmt || wav.channels != _S.wav.channels || wav.freq != _S.wav.freq || wav.data_bytes == 0) {
+		ERR("Stream(%s): Reload skipped, the format changed\n", _S.path);
+		Wav_Close(wav);
+		return;
+	}
+	Wav_Close(_S.wav);
+	_S.wav = wav;
+	Stream_SetLoop(_S);
+	if (_S.read_pos >= _S.loop_end)
+		_S.read_pos = _S.loop_start;
+}
+
+// fills one buffer straight from the mapping when the data needs no conversion,
+// else through the scratch (also used to stitch the end and the start when looping).
+static bool Stream_Fill(SStream& _S, ALuint _Buf)
+{
+	const SWavFile& W = _S.wav;
+	const Uint32 want = STREAM_BUFFER_FRAMES * W.block_align;
+
+	if (_S.read_pos >= Stream_End(_S)) {
+		if (!_S.loop || _S.loop_end == 0)
+			return false;
+		Stream_Wrap(_S);
+	}
+
+	Uint32 n = Stream_End(_S) - _S.read_pos;
+	if (_S.src_fmt == _S.dst_fmt && (n >= want || !_S.loop)) {
+		const Uint8* src = W.data + _S.read_pos;
+		if (n > want)
+			n = want;
+		_S.read_pos += n;
+		alBufferData(_Buf, _S.format, src, n, W.freq);
+		Wav_Release(W, src, n);
+		return true;
+	}
+
+	const int src_bytes = Pcm_Bytes(_S.src_fmt);
+	const int dst_bytes = Pcm_Bytes(_S.dst_fmt);
+	Uint8* out = _S.scratch;
+	Uint32 got = 0;
+	while (got < want) {
+		if (_S.read_pos >= Stream_End(_S)) {
+			if (!_S.loop)
+				break;
+			Stream_Wrap(_S);
+		}
+		n = Stream_End(_S) - _S.read_pos;
+		if (n > want - got)
+			n = want - got;
+		Pcm_Convert(_S.src_fmt, _S.dst_fmt, W.data + _S.read_pos, out, n / src_bytes);
+		Wav_Release(W, W.data + _S.read_pos, n);
+		out += n / src_bytes * dst_bytes;
+		got += n;
+		_S.read_pos += n;
+	}
+	alBufferData(_Buf, _S.format, _S.scratch, out - _S.scratch, W.freq);
+	return true;
+}
+
+static void Stream_Service(SStream& _S)
+{
+	if (_S.source == 0)
+		return;
+
+	ALint processed = 0;
+	alGetSourcei(_S.source, AL_BUFFERS_PROCESSED, &processed);
+	if (processed > 0) {
+		alSourceUnqueueBuffers(_S.source, processed, _S.free + _S.cFree);
+		_S.cFree += processed;
+	}
+
+	while (_S.cFree > 0) {
+		ALuint buf = _S.free[_S.cFree-1];
+		if (!Stream_Fill(_S, buf))
+			break;
+		alSourceQueueBuffers(_S.source, 1, &buf);
+		_S.cFree--;
+	}
+}
+
+static int Stream_Thread(void*)
+{
+	while (SDL_AtomicGet(&s_Quit) == 0) {
+		SDL_LockMutex(s_Lock);
+		for (int i = 0; i < s_cStreams; i++)
+			Stream_Service(*s_Streams[i]);
+		SDL_UnlockMutex(s_Lock);
+
+		SDL_Delay(STREAM_PERIOD_MS);
+	}
+	return 0;
+}
+
+bool Stream_Init()
+{
+	SDL_AtomicSet(&s_Quit, 0);
+	s_cStreams = 0;
+	s_Lock = SDL_CreateMutex();
+	s_Thread = SDL_CreateThread(Stream_Thread, "stream", NULL);
+	if (s_Thread == NULL) {
+		ERR("Stream_Init: SDL_CreateThread failed: %s\n", SDL_GetError());
+		SDL_DestroyMutex(s_Lock);	s_Lock = NULL;
+		return false;
+	}
+	return true;
+}
+
+void Stream_Shutdown()
+{
+	if (s_Thread == NULL)
+		return;
+	SDL_AtomicSet(&s_Quit, 1);
+	SDL_WaitThread(s_Thread, NULL);		s_Thread = NULL;
+	SDL_DestroyMutex(s_Lock);			s_Lock = NULL;
+}
+
+
+// -------------------  streams -------------------------
+SStream* Stream_Open(const char* _Path, bool _Loop)
+{
+	if (s_cStreams == STREAM_MAX_STREAMS) {
+		ERR("Stream_Open(%s): Too many streams\n", _Path);
+		return NULL;
+	}
+
+	SStream* S = (SStream*)calloc(1, sizeof(SStream));
+	if (!Wav_Open(_Path, S->wav)) {
+		free(S);
+		return NULL;
+	}
+	S->src_fmt = Wav_PcmFormat(S->wav);
+	S->dst_fmt = Pcm_TargetFormat(S->src_fmt);
+	S->format = Sound_ALFormat(S->dst_fmt, S->wav.channels);
+	if (S->format == 0) {
+		ERR("Stream_Open(%s): Unsupported format: tag=0x%X %s channels=%d\n", _Path, S->wav.tag, Pcm_Name(S->src_fmt), S->wav.channels);
+		Wav_Close(S->wav);
+		free(S);
+		return NULL;
+	}
+	strncpy(S->path, _Path, sizeof(S->path)-1);
+	S->frame_bytes = S->wav.channels * Pcm_Bytes(S->dst_fmt);
+	S->loop = _Loop;
+	Stream_SetLoop(*S);
+
+	S->scratch = (Uint8*)malloc(STREAM_BUFFER_FRAMES * S->frame_bytes);
+	alGenBuffers(STREAM_NUM_BUFFERS, S->buffers);
+	memcpy(S->free, S->buffers, sizeof(S->buffers));
+	S->cFree = STREAM_NUM_BUFFERS;
+
+	SDL_LockMutex(s_Lock);
+	s_Streams[s_cStreams] = S;	s_cStreams++;
+	SDL_UnlockMutex(s_Lock);
+
+	return S;
+}
+
+void Stream_Close(SStream* _Stream)
+{
+	if (_Stream == NULL)
+		return;
+
+	Stream_Attach(_Stream, 0);
+
+	SDL_LockMutex(s_Lock);
+	for (int i = 0; i < s_cStreams; i++) {
+		if (s_Streams[i] == _Stream) {
+			s_Streams[i] = s_Streams[s_cStreams-1];	s_cStreams--;
+			break;
+		}
+	}
+	SDL_UnlockMutex(s_Lock);
+
+	alDeleteBuffers(STREAM_NUM_BUFFERS, _Stream->buffers);
+	Wav_Close(_Stream->wav);
+	free(_Stream->scratch);
+	free(_Stream);
+}
+
+void Stream_Attach(SStream* _Stream, ALuint _Source)
+{
+	SDL_LockMutex(s_Lock);
+
+	if (_Stream->source != 0) {
+		// stopping marks the whole queue as processed, clearing AL_BUFFER unqueues it.
+		alSourceStop(_Stream->source);
+		alSourcei(_Stream->source, AL_BUFFER, 0);
+		memcpy(_Stream->free, _Stream->buffers, sizeof(_Stream->buffers));
+		_Stream->cFree = STREAM_NUM_BUFFERS;
+	}
+
+	_Stream->source = _Source;
+	if (_Source != 0) {
+		alSourceStop(_Source);
+		alSourcei(_Source, AL_BUFFER, 0);
+		alSourcei(_Source, AL_LOOPING, AL_FALSE);		// looping is done by the stream
+	}
+
+	SDL_UnlockMutex(s_Lock);
+}
+
+const char* Stream_Path(const SStream* _Stream)
+{
+	return _Stream->path;
+}
+
+void Stream_Reload(SStream* _Stream)
+{
+	SDL_AtomicSet(&_Stream->reload, 1);
+}
+
+int Stream_ResidentBytes(const SStream* _Stream)
+{
+	// AL side copies of the ring + the decode scratch.
+	return (STREAM_NUM_BUFFERS + 1) * STREAM_BUFFER_FRAMES * _Stream->frame_bytes;
+}
@@ -0,0 +1,23 @@
+// Streaming playback: a background thread decodes long files into a small
+// ring of AL buffers queued on a source, so only a few hundred KB are resident.
+
+#pragma once
+
+#include <AL/al.h>
+
+struct SStream;
+
+bool		Stream_Init();
+void		Stream_Shutdown();
+
+SStream*	Stream_Open(const char* _Path, bool _Loop);
+void		Stream_Close(SStream* _Stream);
+
+// hands the buffer queue of _Source over to the stream thread (0 to detach).
+void		Stream_Attach(SStream* _Stream, ALuint _Source);
+
+const char*	Stream_Path(const SStream* _Stream);
+// looping streams switch to the new file at their next loop, if it has the same format.
+void		Stream_Reload(SStream* _Stream);
+
+int			Stream_ResidentBytes(const SStream* _Stream);
@@ -0,0 +1,229 @@
+// testbed-pack: bakes a directory of wav files into a sound pack.
+//	usage: testbed-pack <dir> <out.pak>
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "pcm.h"
+#include "wav.h"
+#include "soundpack.h"
+
+#define PACK_MAX_FILES	4096
+
+struct SPackFile {
+	char		name[256];		// relative to the packed directory
+	SPackEntry	entry;
+};
+
+static SPackFile	s_Files[PACK_MAX_FILES];
+static int			s_cFiles = 0;
+
+static bool EndsWith(const char* _Str, const char* _Suffix)
+{
+	size_t n = strlen(_Str), m = strlen(_Suffix);
+	return n >= m && strcasecmp(_Str + n - m, _Suffix) == 0;
+}
+
+// drops a half written pack (but never a device or pipe given as the output).
+static void RemoveOutput(const char* _Path)
+{
+	struct stat st;
+	if (stat(_Path, &st) == 0 && S_ISREG(st.st_mode))
+		remove(_Path);
+}
+
+static void Scan(const char* _Root, const char* _Rel)
+{
+	char path[512];
+	if (snprintf(path, sizeof(path), "%s/%s", _Root, _Rel) >= (int)sizeof(path)) {
+		ERR("%s/%s: path too long, skipped\n", _Root, _Rel);
+		return;
+	}
+	DIR* dir = opendir(path);
+	if (dir == NULL)
+		return;
+
+	while (struct dirent* de = readdir(dir)) {
+		if (de->d_name[0] == '.')
+			continue;
+		// (a truncated name would be packed as another)
+		char rel[256];
+		if (snprintf(rel, sizeof(rel), "%s%s%s", _Rel, _Rel[0] ? "/" : "", de->d_name) >= (int)sizeof(rel)
+		||	snprintf(path, sizeof(path), "%s/%s", _Root, rel) >= (int)sizeof(path)) {
+			ERR("%s/%s%s%s: path too long, skipped\n", _Root, _Rel, _Rel[0] ? "/" : "", de->d_name);
+			continue;
+		}
+
+		struct stat st;
+		if (stat(path, &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			Scan(_Root, rel);
+		else if (EndsWith(rel, ".wav") && s_cFiles < PACK_MAX_FILES) {
+			strcpy(s_Files[s_cFiles].name, rel);
+			s_cFiles++;
+		}
+	}
+	closedir(dir);
+}
+
+static int CompareFiles(const void* a, const void* b)
+{
+	return strcmp(((const SPackFile*)a)->name, ((const SPackFile*)b)->name);
+}
+
+static uint64_t AlignUp(uint64_t _Offset)
+{
+	return (_Offset + PACK_ALIGN-1) & ~(uint64_t)(PACK_ALIGN-1);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3) {
+		ERR("usage: %s <dir> <out.pak>\n", argv[0]);
+		return 1;
+	}
+	const char* root = argv[1];
+	const char* out = argv[2];
+
+	Scan(root, "");
+	qsort(s_Files, s_cFiles, sizeof(SPackFile), CompareFiles);
+
+	// pass 1: formats and sizes
+	int cEntries = 0;
+	for (int i = 0; i < s_cFiles; i++) {
+		SPackFile& F = s_Files[i];
+		char path[512];
+		if (snprintf(path, sizeof(path), "%s/%s", root, F.name) >= (int)sizeof(path)) {
+			ERR("%s: path too long, skipped\n", F.name);
+			continue;
+		}
+
+		SWavFile wav;
+		if (!Wav_Open(path, wav))
+			continue;
+		// stored converted to what OpenAL takes.
+		const int src = Wav_PcmFormat(wav);
+		const int dst = Pcm_TargetFormat(src);
+		ALenum format = Pcm_ALFormat(dst, wav.channels);
+		if (format == 0) {
+			ERR("%s: unsupported format, skipped: tag=0x%X %s channels=%d\n", F.name, wav.tag, Pcm_Name(src), wav.channels);
+			Wav_Close(wav);
+			continue;
+		}
+
+		SPackEntry& E = F.entry;
+		E.hash = HashName(F.name);
+		E.format = format;
+		E.freq = wav.freq;
+		E.channels = wav.channels;
+		E.bytes = wav.data_bytes / Pcm_Bytes(src) * Pcm_Bytes(dst);
+		if (wav.has_loop) {
+			E.loop_start = wav.loop_start;
+			E.loop_end = wav.loop_end;
+		}
+		Wav_Close(wav);
+		cEntries++;
+	}
+
+	// table of contents: at most half full, linear probing.
+	SPackHeader H;
+	memset(&H, 0, sizeof(H));
+	H.magic = PACK_MAGIC;
+	H.version = PACK_VERSION;
+	H.cEntries = cEntries;
+	H.cSlots = 2;
+	while (H.cSlots < 2*(uint32_t)cEntries)
+		H.cSlots *= 2;
+
+	// the names after the table, then the data.
+	SPackEntry* slots = (SPackEntry*)calloc(H.cSlots, sizeof(SPackEntry));
+	const uint64_t names = sizeof(H) + H.cSlots * sizeof(SPackEntry);
+	uint64_t names_end = names;
+	for (int i = 0; i < s_cFiles; i++) {
+		if (s_Files[i].entry.hash != 0) {
+			s_Files[i].entry.name = names_end;
+			names_end += strlen(s_Files[i].name) + 1;
+		}
+	}
+	uint64_t offset = AlignUp(names_end);
+	for (int i = 0; i < s_cFiles; i++) {
+		SPackEntry& E = s_Files[i].entry;
+		if (E.hash == 0)
+			continue;
+		E.offset = offset;
+		offset = AlignUp(offset + E.bytes);
+
+		// (told apart by name at runtime, a collision only costs a probe)
+		uint32_t slot = E.hash & (H.cSlots-1);
+		while (slots[slot].hash != 0)
+			slot = (slot+1) & (H.cSlots-1);
+		slots[slot] = E;
+	}
+
+	// pass 2: write
+	FILE* f = fopen(out, "wb");
+	if (f == NULL) {
+		ERR("%s: cannot create\n", out);
+		return 1;
+	}
+	// a short write leaves no pack behind.
+	bool ok = fwrite(&H, sizeof(H), 1, f) == 1
+		&&	fwrite(slots, sizeof(SPackEntry), H.cSlots, f) == H.cSlots;
+	for (int i = 0; ok && i < s_cFiles; i++) {
+		const size_t n = strlen(s_Files[i].name) + 1;
+		if (s_Files[i].entry.hash != 0)
+			ok = fwrite(s_Files[i].name, 1, n, f) == n;
+	}
+
+	uint64_t total = 0;
+	for (int i = 0; ok && i < s_cFiles; i++) {
+		const SPackEntry& E = s_Files[i].entry;
+		if (E.hash == 0)
+			continue;
+		char path[512];
+		SWavFile wav;
+		const bool fits = snprintf(path, sizeof(path), "%s/%s", root, s_Files[i].name) < (int)sizeof(path);
+		const int src = fits && Wav_Open(path, wav) ? Wav_PcmFormat(wav) : PCM_UNKNOWN;
+		const int dst = Pcm_TargetFormat(src);
+		if (src == PCM_UNKNOWN || wav.data_bytes / Pcm_Bytes(src) * Pcm_Bytes(dst) != E.bytes) {
+			ERR("%s: changed while packing\n", s_Files[i].name);
+			if (src != PCM_UNKNOWN)
+				Wav_Close(wav);
+			fclose(f);
+			RemoveOutput(out);
+			return 1;
+		}
+		ok = fseek(f, E.offset, SEEK_SET) == 0;
+		if (ok && src == dst)
+			ok = fwrite(wav.data, 1, E.bytes, f) == E.bytes;
+		else if (ok) {
+			void* converted = malloc(E.bytes);
+			Pcm_Convert(src, dst, wav.data, converted, wav.data_bytes / Pcm_Bytes(src));
+			ok = fwrite(converted, 1, E.bytes, f) == E.bytes;
+			free(converted);
+		}
+		Wav_Close(wav);
+
+		printf("%-40s %6u KB  %5u Hz  %u ch\n", s_Files[i].name, E.bytes/1024, E.freq, E.channels);
+		total += E.bytes;
+	}
+
+	// pad the last entry up to the alignment so that its pages are whole.
+	if (ok && ftell(f) < (long)offset)
+		ok = fseek(f, offset-1, SEEK_SET) == 0 && fputc(0, f) != EOF;
+	if (fclose(f) != 0)
+		ok = false;
+	free(slots);
+	if (!ok) {
+		ERR("%s: write failed\n", out);
+		RemoveOutput(out);
+		return 1;
+	}
+
+	printf("%s: %d sounds, %llu KB\n", out, cEntries, (unsigned long long)total/1024);
+	return 0;
+}
@@ -0,0 +1,62 @@
+// directory watch
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "common.h"
+#include "watch.h"
+
+struct SWatchState {
+	int		fd;
+	int		wd;
+	char	events[4096] __attribute__((aligned(__alignof__(inotify_event))));
+	int		len;
+	int		pos;
+};
+static SWatchState s_Watch = { -1, -1 };
+
+bool Watch_Init(const char* _Dir)
+{
+	Watch_Shutdown();
+	s_Watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (s_Watch.fd < 0) {
+		ERR("Watch_Init(%s): inotify_init1 failed\n", _Dir);
+		return false;
+	}
+	// editors either rewrite the file or move a new one over it.
+	s_Watch.wd = inotify_add_watch(s_Watch.fd, _Dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (s_Watch.wd < 0) {
+		ERR("Watch_Init(%s): inotify_add_watch failed\n", _Dir);
+		Watch_Shutdown();
+		return false;
+	}
+	return true;
+}
+
+void Watch_Shutdown()
+{
+	if (s_Watch.fd >= 0)
+		close(s_Watch.fd);
+	s_Watch.fd = s_Watch.wd = -1;
+	s_Watch.len = s_Watch.pos = 0;
+}
+
+const char* Watch_Next()
+{
+	if (s_Watch.fd < 0)
+		return NULL;
+	for (;;) {
+		if (s_Watch.pos >= s_Watch.len) {
+			ssize_t n = read(s_Watch.fd, s_Watch.events, sizeof(s_Watch.events));
+			if (n <= 0)
+				return NULL;		// EAGAIN: nothing pending
+			s_Watch.len = (int)n;
+			s_Watch.pos = 0;
+		}
+		const inotify_event* e = (const inotify_event*)(s_Watch.events + s_Watch.pos);
+		s_Watch.pos += sizeof(inotify_event) + e->len;
+		if (e->len > 0 && !(e->mask & IN_ISDIR))
+			return e->name;
+	}
+}
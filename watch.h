@@ -0,0 +1,10 @@
+// inotify watch of one directory: the files written or moved in are reported
+// by name, polled from the main loop without ever blocking.
+
+#pragma once
+
+bool		Watch_Init(const char* _Dir);
+void		Watch_Shutdown();
+
+// next changed file, relative to the directory, NULL when none (valid until the next call).
+const char*	Watch_Next();
@@ -0,0 +1,224 @@
+// RIFF/WAVE chunk parser
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "pcm.h"
+#include "wav.h"
+
+#define FOURCC(a,b,c,d)		((uint32_t)(a) | ((uint32_t)(b)<<8) | ((uint32_t)(c)<<16) | ((uint32_t)(d)<<24))
+
+// chunk ids are compared as read in file order, sizes and fields follow the file endianness.
+static uint32_t Wav_Id(const uint8_t* p)
+{
+	return FOURCC(p[0], p[1], p[2], p[3]);
+}
+static uint16_t Wav_U16(const uint8_t* p, bool _BE)
+{
+	return _BE ? (uint16_t)((p[0]<<8) | p[1]) : (uint16_t)(p[0] | (p[1]<<8));
+}
+static uint32_t Wav_U32(const uint8_t* p, bool _BE)
+{
+	return _BE	? ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | p[3]
+				: ((uint32_t)p[3]<<24) | ((uint32_t)p[2]<<16) | ((uint32_t)p[1]<<8) | p[0];
+}
+
+static void Wav_String(char* _Dst, size_t _DstSize, const uint8_t* _Src, uint32_t _Size)
+{
+	size_t n = _Size < _DstSize-1 ? _Size : _DstSize-1;
+	memcpy(_Dst, _Src, n);
+	_Dst[n] = 0;
+}
+
+static void Wav_ParseInfo(SWavFile& _Wav, const uint8_t* p, uint32_t _Size)
+{
+	const uint8_t* end = p + _Size;
+	while (end - p >= 8) {
+		uint32_t id = Wav_Id(p);
+		uint32_t size = Wav_U32(p+4, _Wav.big_endian);
+		p += 8;
+		if (size > (uint32_t)(end - p))
+			size = end - p;
+		if (id == FOURCC('I','N','A','M'))
+			Wav_String(_Wav.title, sizeof(_Wav.title), p, size);
+		else if (id == FOURCC('I','C','M','T'))
+			Wav_String(_Wav.comment, sizeof(_Wav.comment), p, size);
+		if (size + (size & 1) >= (size_t)(end - p))
+			break;		// (the pad byte of a truncated last chunk may be missing)
+		p += size + (size & 1);
+	}
+}
+
+bool Wav_Parse(const void* _Mem, size_t _Size, SWavFile& _Wav, const char* _Name)
+{
+	memset(&_Wav, 0, sizeof(_Wav));
+
+	const uint8_t* p = (const uint8_t*)_Mem;
+	const uint8_t* end = p + _Size;
+	if (_Size < 12 || Wav_Id(p+8) != FOURCC('W','A','V','E')) {
+		ERR("Wav_Parse(%s): not a WAVE file\n", _Name);
+		return false;
+	}
+	if (Wav_Id(p) == FOURCC('R','I','F','X'))
+		_Wav.big_endian = true;
+	else if (Wav_Id(p) != FOURCC('R','I','F','F')) {
+		ERR("Wav_Parse(%s): not a RIFF file\n", _Name);
+		return false;
+	}
+	const bool BE = _Wav.big_endian;
+	uint32_t fact_frames = 0;
+
+	// the riff size is often wrong in the wild, walk up to the end of the file instead.
+	p += 12;
+	while (end - p >= 8) {
+		uint32_t id = Wav_Id(p);
+		uint32_t size = Wav_U32(p+4, BE);
+		p += 8;
+		if (size > (uint32_t)(end - p))
+			size = end - p;		// truncated file
+
+		if (id == FOURCC('f','m','t',' ') && size >= 16) {
+			_Wav.tag = Wav_U16(p, BE);
+			_Wav.channels = Wav_U16(p+2, BE);
+			_Wav.freq = Wav_U32(p+4, BE);
+			_Wav.block_align = Wav_U16(p+12, BE);
+			_Wav.bits = Wav_U16(p+14, BE);
+			if (size >= 20)
+				_Wav.samples_per_block = Wav_U16(p+18, BE);	// (ADPCM, after cbSize)
+			if (_Wav.tag == WAV_FORMAT_EXTENSIBLE && size >= 40)
+				_Wav.tag = Wav_U16(p+24, BE);		// first two bytes of the sub format guid
+		} else if (id == FOURCC('f','a','c','t') && size >= 4) {
+			fact_frames = Wav_U32(p, BE);
+		} else if (id == FOURCC('d','a','t','a')) {
+			_Wav.data = p;
+			_Wav.data_bytes = size;
+		} else if (id == FOURCC('s','m','p','l') && size >= 36) {
+			uint32_t cLoops = Wav_U32(p+28, BE);
+			if (cLoops > 0 && size >= 36 + 24) {
+				const uint8_t* loop = p + 36;
+				uint32_t start = Wav_U32(loop+8, BE);
+				uint32_t last = Wav_U32(loop+12, BE);		// inclusive
+				if (last >= start) {
+					_Wav.has_loop = true;
+					_Wav.loop_start = start;
+					_Wav.loop_end = last + 1;
+				}
+			}
+		} else if (id == FOURCC('L','I','S','T') && size >= 4) {
+			if (Wav_Id(p) == FOURCC('I','N','F','O'))
+				Wav_ParseInfo(_Wav, p+4, size-4);
+		}
+
+		if (size + (size & 1) >= (size_t)(end - p))
+			break;		// (the pad byte of a truncated last chunk may be missing)
+		p += size + (size & 1);
+	}
+
+	if (_Wav.channels == 0) {
+		ERR("Wav_Parse(%s): no fmt chunk\n", _Name);
+		return false;
+	}
+	if (_Wav.data == NULL) {
+		ERR("Wav_Parse(%s): no data chunk\n", _Name);
+		return false;
+	}
+	if (_Wav.block_align > 0)
+		_Wav.data_bytes -= _Wav.data_bytes % _Wav.block_align;
+
+	if (_Wav.tag == WAV_FORMAT_ADPCM || _Wav.tag == WAV_FORMAT_IMA_ADPCM) {
+		// the last block is padded, the fact chunk has the real length.
+		_Wav.frames = _Wav.block_align > 0 ? _Wav.data_bytes / _Wav.block_align * _Wav.samples_per_block : 0;
+		if (fact_frames > 0 && fact_frames < _Wav.frames)
+			_Wav.frames = fact_frames;
+	} else {
+		_Wav.frames = _Wav.block_align > 0 ? _Wav.data_bytes / _Wav.block_align : 0;
+	}
+
+	if (_Wav.has_loop) {
+		if (_Wav.loop_end > _Wav.frames)
+			_Wav.loop_end = _Wav.frames;
+		if (_Wav.loop_start >= _Wav.loop_end) {
+			_Wav.has_loop = false;
+			_Wav.loop_start = _Wav.loop_end = 0;
+		}
+	}
+
+	return true;
+}
+
+bool Wav_Open(const char* _Path, SWavFile& _Wav)
+{
+	memset(&_Wav, 0, sizeof(_Wav));
+
+	int fd = open(_Path, O_RDONLY);
+	if (fd < 0) {
+		ERR("Wav_Open(%s): cannot open\n", _Path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		ERR("Wav_Open(%s): cannot stat or empty file\n", _Path);
+		close(fd);
+		return false;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		ERR("Wav_Open(%s): mmap failed\n", _Path);
+		return false;
+	}
+
+	if (!Wav_Parse(map, st.st_size, _Wav, _Path)) {
+		munmap(map, st.st_size);
+		return false;
+	}
+	_Wav.map = map;
+	_Wav.map_size = st.st_size;
+	return true;
+}
+
+void Wav_Close(SWavFile& _Wav)
+{
+	if (_Wav.map)
+		munmap(_Wav.map, _Wav.map_size);
+	memset(&_Wav, 0, sizeof(_Wav));
+}
+
+int Wav_PcmFormat(const SWavFile& _Wav)
+{
+	if (_Wav.channels == 0 || _Wav.block_align % _Wav.channels != 0)
+		return PCM_UNKNOWN;
+
+	// the container size decides, 24 bits in 4 bytes read as S32.
+	const bool BE = _Wav.big_endian;
+	const int bytes = _Wav.block_align / _Wav.channels;
+	if (_Wav.tag == WAV_FORMAT_PCM) {
+		switch (bytes) {
+		case 1:	return PCM_U8;
+		case 2:	return BE ? PCM_S16BE : PCM_S16;
+		case 3:	return BE ? PCM_S24BE : PCM_S24;
+		case 4:	return BE ? PCM_S32BE : PCM_S32;
+		}
+	} else if (_Wav.tag == WAV_FORMAT_IEEE_FLOAT) {
+		switch (bytes) {
+		case 4:	return BE ? PCM_F32BE : PCM_F32;
+		case 8:	return BE ? PCM_F64BE : PCM_F64;
+		}
+	}
+	return PCM_UNKNOWN;
+}
+
+void Wav_Release(const SWavFile& _Wav, const void* _Ptr, size_t _Size)
+{
+	if (_Wav.map == NULL || _Size == 0)
+		return;
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t begin = ((uintptr_t)_Ptr + page-1) & ~(page-1);
+	uintptr_t end = ((uintptr_t)_Ptr + _Size) & ~(page-1);
+	if (end > begin)
+		madvise((void*)begin, end - begin, MADV_DONTNEED);
+}
@@ -0,0 +1,52 @@
+// RIFF/WAVE parser working in place on a memory mapped file:
+// the data chunk pointer can be handed straight to alBufferData.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WAV_FORMAT_PCM			0x0001
+#define WAV_FORMAT_ADPCM		0x0002		// Microsoft ADPCM
+#define WAV_FORMAT_IEEE_FLOAT	0x0003
+#define WAV_FORMAT_IMA_ADPCM	0x0011
+#define WAV_FORMAT_EXTENSIBLE	0xFFFE
+
+struct SWavFile {
+	// mapping (NULL when parsed from caller owned memory)
+	void*			map;
+	size_t			map_size;
+
+	// fmt
+	bool			big_endian;		// RIFX
+	int				tag;			// WAV_FORMAT_xx, sub format resolved for extensible files
+	int				channels;
+	int				freq;
+	int				block_align;
+	int				bits;
+	int				samples_per_block;	// ADPCM, frames per block
+
+	// data
+	const uint8_t*	data;
+	uint32_t		data_bytes;
+	uint32_t		frames;				// (fact chunk for ADPCM, when present)
+
+	// smpl: first sustain loop, in sample frames, end exclusive (0 when none)
+	bool			has_loop;
+	uint32_t		loop_start;
+	uint32_t		loop_end;
+
+	// LIST/INFO
+	char			title[64];		// INAM
+	char			comment[128];	// ICMT
+};
+
+bool		Wav_Open(const char* _Path, SWavFile& _Wav);
+void		Wav_Close(SWavFile& _Wav);
+bool		Wav_Parse(const void* _Mem, size_t _Size, SWavFile& _Wav, const char* _Name);
+
+// EPcmFormat of the data chunk, PCM_UNKNOWN if not plain PCM.
+int			Wav_PcmFormat(const SWavFile& _Wav);
+
+// drops the pages of [_Ptr, _Ptr+_Size) from the process working set.
+void		Wav_Release(const SWavFile& _Wav, const void* _Ptr, size_t _Size);